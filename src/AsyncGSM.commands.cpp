@@ -8,10 +8,12 @@ bool AsyncGSM::isConnected() {
 }
 
 bool AsyncGSM::modemConnect(const char *host, uint16_t port) {
-  return ctx->modem().connect(host, port);
+  if (socketId < 0) return false;
+  return ctx->modem().connect(host, port, static_cast<uint8_t>(socketId));
 }
 
 bool AsyncGSM::modemStop() {
-  ctx->modem().stop();
+  if (socketId < 0) return false;
+  ctx->modem().stop(static_cast<uint8_t>(socketId));
   return true;
 }
@@ -8,16 +8,34 @@
 
 AsyncGSM::AsyncGSM(GSMContext &context) {
   ctx = &context;
-  ctx->transport().setDefaultSSL(isSecure());
+  attachSocket();
 }
 
 AsyncGSM::AsyncGSM() {
   owns = true;
   ctx = new GSMContext();
-  ctx->transport().setDefaultSSL(isSecure());
+  attachSocket();
+}
+
+void AsyncGSM::attachSocket() {
+  socketId = ctx->acquireSocket();
+  if (socketId < 0) {
+    log_e("No free modem socket for this client");
+    return;
+  }
+  rx = &ctx->transport(static_cast<uint8_t>(socketId));
+  // The transport may still hold bytes from a previous owner of this connectID
+  rx->reset();
+  rx->setDefaultSSL(isSecure());
+}
+
+ConnectionStatus AsyncGSM::socketStatus() {
+  if (socketId < 0) return ConnectionStatus::DISCONNECTED;
+  return ctx->modem().URCState.socketState[socketId].load();
 }
 
 AsyncGSM::~AsyncGSM() {
+  if (ctx) { ctx->releaseSocket(socketId); }
   if (owns && ctx) {
     delete ctx;
     ctx = nullptr;
@@ -38,16 +56,16 @@ int AsyncGSM::connect(const char *host, uint16_t port) {
 }
 
 void AsyncGSM::stop() {
+  if (!rx) return;
   modemStop();
-  ctx->transport().reset();
+  rx->reset();
   log_d("Connection stopped.");
 }
 
 size_t AsyncGSM::write(uint8_t c) { return write(&c, 1); }
 
 size_t AsyncGSM::write(const uint8_t *buf, size_t size) {
-  if (ctx->modem().URCState.isConnected.load() != ConnectionStatus::CONNECTED ||
-      !ctx->at().getStream()) {
+  if (socketStatus() != ConnectionStatus::CONNECTED || !ctx->at().getStream()) {
     log_e("Not connected or stream not initialized");
     return 0;
   }
@@ -55,69 +73,78 @@ size_t AsyncGSM::write(const uint8_t *buf, size_t size) {
   if (size == 0) return 0;
   log_d("Writing %zu bytes to modem...", size);
 
-  String out;
-  out.reserve(size);
-  for (size_t i = 0; i < size; i++) {
-    out += char(buf[i]);  // convert each byte to char
+  // The modem caps a single send; larger buffers go out as back-to-back segments, each one
+  // issued as soon as the previous SEND OK arrives
+  size_t sent = 0;
+  while (sent < size) {
+    size_t remaining = size - sent;
+    size_t segment = remaining < MAX_SEND_SEGMENT ? remaining : MAX_SEND_SEGMENT;
+    if (!writeSegment(buf + sent, segment)) break;
+    sent += segment;
+  }
+
+  if (sent < size) {
+    log_w("Write stopped after %zu of %zu bytes", sent, size);
+  } else {
+    log_d("Write successful.");
   }
-  log_d("Sent bytes: %s", out.c_str());
+  return sent;
+}
+
+bool AsyncGSM::writeSegment(const uint8_t *buf, size_t size) {
+  log_v("Sent bytes: %.*s", static_cast<int>(size), reinterpret_cast<const char *>(buf));
 
-  String command = isSecure() ? "AT+QSSLSEND=0," : "AT+QISEND=0,";
+  String command = isSecure() ? "AT+QSSLSEND=" : "AT+QISEND=";
 
-  ATPromise *promise = ctx->at().sendCommand(command + String(size));
+  ATPromise *promise = ctx->at().sendCommand(command + String(socketId) + "," + String(size));
   if (!promise) {
     log_e("Failed to create promise for AT+QISEND");
-    ctx->at().popCompletedPromise(promise->getId());
-    return 0;
+    return false;
   }
 
-  while (!ctx->at().getStream()->available()) { vTaskDelay(0); }
-  String response;
-  while (ctx->at().getStream()->available()) {
-    char c = ctx->at().getStream()->read();
-    response += c;
-    if (c == '>') { break; }
-  }
-  if (response.indexOf('>') == -1) {
+  // The AT handler resolves the promise on the data prompt; no polling of the raw stream
+  promise->timeout(SEND_PROMPT_TIMEOUT_MS);
+  if (!promise->expect(">")->wait()) {
     log_e("Did not receive prompt '>'");
     ctx->at().popCompletedPromise(promise->getId());
-    return 0;
+    return false;
   }
 
+  // Payload goes out as-is, without staging it in a String
   ctx->at().getStream()->write(buf, size);
   ctx->at().getStream()->flush();
 
-  bool promptReceived = promise->expect("SEND OK")->wait();
+  bool sendConfirmed = promise->expect("SEND OK")->wait();
 
-  auto p = ctx->at().popCompletedPromise(promise->getId());
-  if (!promptReceived) {
+  ctx->at().popCompletedPromise(promise->getId());
+  if (!sendConfirmed) {
     log_e("Failed to get SEND OK confirmation");
-    return 0;
+    return false;
   }
-
-  log_d("Write successful.");
-  return size;
+  return true;
 }
 
-int AsyncGSM::available() { return static_cast<int>(ctx->transport().available()); }
+int AsyncGSM::available() { return rx ? static_cast<int>(rx->available()) : 0; }
 
 int AsyncGSM::read() {
-  if (ctx->modem().URCState.isConnected.load() == ConnectionStatus::CLOSING && available() == 0) {
-    ctx->modem().URCState.isConnected.store(ConnectionStatus::DISCONNECTED);
+  if (!rx) return -1;
+  if (socketStatus() == ConnectionStatus::CLOSING && available() == 0) {
+    ctx->modem().URCState.socketState[socketId].store(ConnectionStatus::DISCONNECTED);
     return -1;
   }
-  return ctx->transport().read();
+  return rx->read();
 }
 
 int AsyncGSM::read(uint8_t *buf, size_t size) {
-  if (ctx->modem().URCState.isConnected.load() == ConnectionStatus::CLOSING && available() == 0) {
-    ctx->modem().URCState.isConnected.store(ConnectionStatus::DISCONNECTED);
+  if (!rx) return 0;
+  if (socketStatus() == ConnectionStatus::CLOSING && available() == 0) {
+    ctx->modem().URCState.socketState[socketId].store(ConnectionStatus::DISCONNECTED);
     return 0;
   }
-  return static_cast<int>(ctx->transport().read(buf, size));
+  return static_cast<int>(rx->read(buf, size));
 }
 
-int AsyncGSM::peek() { return ctx->transport().peek(); }
+int AsyncGSM::peek() { return rx ? rx->peek() : -1; }
 
 void AsyncGSM::flush() {
   log_w("Flushing stream...");
@@ -125,10 +152,10 @@ void AsyncGSM::flush() {
     log_e("Stream not initialized");
     return;
   }
-  ctx->transport().flush();
+  if (rx) { rx->flush(); }
 }
 
 uint8_t AsyncGSM::connected() {
-  auto status = ctx->modem().URCState.isConnected.load();
+  auto status = socketStatus();
   return status == ConnectionStatus::CONNECTED || status == ConnectionStatus::CLOSING;
 }
@@ -34,14 +34,25 @@ class AsyncGSM : public Client {
   bool gprsDisconnect();
 
   GSMContext &context() { return (*ctx); }
+  // connectID this client owns on the shared modem, -1 if none was free
+  int socket() const { return socketId; }
 
  protected:
+  static constexpr uint32_t SEND_PROMPT_TIMEOUT_MS = 5000;
+  // Largest payload the EG915 accepts in one AT+QISEND/AT+QSSLSEND
+  static constexpr size_t MAX_SEND_SEGMENT = 1460;
+
   bool owns = false;
   GSMContext *ctx;
+  int socketId{-1};
+  GSMTransport *rx{nullptr};
+  ConnectionStatus socketStatus();
+  void attachSocket();
   virtual bool isSecure() const { return false; }
 
   virtual bool modemConnect(const char *host, uint16_t port);
   virtual bool modemStop();
+  bool writeSegment(const uint8_t *buf, size_t size);
   int8_t getRegistrationStatusXREG(const char *regCommand);
   RegStatus getRegistrationStatus();
 
@@ -1,21 +1,30 @@
 #include "AsyncMqttGSM.h"
 
+#include <algorithm>
+
 #include "esp_log.h"
 
 AsyncMqttGSM::AsyncMqttGSM(GSMContext &context) {
   ctx = &context;
-  ctx->modem().mqttQueueSub = &mqttQueueSub;
+  ctx->modem().setMqttQueue(&mqttQueueSub);
+  ctx->modem().mqttPublishWindow = &publishWindow;
 }
 
 AsyncMqttGSM::AsyncMqttGSM() {
   owns = true;
   ctx = new GSMContext();
-  ctx->modem().mqttQueueSub = &mqttQueueSub;
+  ctx->modem().setMqttQueue(&mqttQueueSub);
+  ctx->modem().mqttPublishWindow = &publishWindow;
 }
 
 AsyncMqttGSM::~AsyncMqttGSM() {
+  stopDispatchTask();
+  if (dispatchStopped) vSemaphoreDelete(dispatchStopped);
   // Detach our queue from the shared modem to avoid dangling pointer
-  if (ctx && ctx->modem().mqttQueueSub == &mqttQueueSub) { ctx->modem().mqttQueueSub = nullptr; }
+  if (ctx && ctx->modem().mqttQueueSub == &mqttQueueSub) { ctx->modem().setMqttQueue(nullptr); }
+  if (ctx && ctx->modem().mqttPublishWindow == &publishWindow) {
+    ctx->modem().mqttPublishWindow = nullptr;
+  }
   if (owns && ctx) {
     delete ctx;
     ctx = nullptr;
@@ -25,7 +34,8 @@ AsyncMqttGSM::~AsyncMqttGSM() {
 bool AsyncMqttGSM::init() {
   log_d("Initializing AsyncMqttGSM...");
 
-  if (!ctx->at().sendSync(String("AT+QMTCFG=\"recv/mode\",") + cidx + ",1")) {
+  // Buffer mode with the payload length in every AT+QMTRECV reply, so payloads are read by size
+  if (!ctx->at().sendSync(String("AT+QMTCFG=\"recv/mode\",") + cidx + ",1,1")) {
     log_e("Failed to set Receive mode");
     return false;
   }
@@ -47,8 +57,9 @@ bool AsyncMqttGSM::init() {
     return false;
   }
 
-  // Set clean session to 1 (true)
-  if (!ctx->at().sendSync(String("AT+QMTCFG=\"session\",") + cidx + ",0")) {
+  // With clean session off the broker keeps subscriptions and queued QoS 1/2 messages
+  if (!ctx->at().sendSync(
+          String("AT+QMTCFG=\"session\",") + cidx + "," + (cleanSession ? "1" : "0"))) {
     log_e("Failed to set session");
     return false;
   }
@@ -78,6 +89,8 @@ bool AsyncMqttGSM::connect(const char *apn, const char *user, const char *pass)
 
   // restarts connection process
   ctx->modem().URCState.mqttState.store(MqttConnectionState::IDLE);
+  // Acks from a previous session will never arrive
+  publishWindow.failAll();
 
   ATPromise *mqttPromise = ctx->at().sendCommand(
       String("AT+QMTOPEN=") + cidx + ",\"" + String(domain) + "\"," + String(port));
@@ -122,81 +135,254 @@ bool AsyncMqttGSM::connect(const char *apn, const char *user, const char *pass)
 }
 
 bool AsyncMqttGSM::publish(const char *topic, const uint8_t *payload, unsigned int plength) {
-  // Client: 0, msgId: 1, qos: 1, retain: 0
-  String cmd = String("AT+QMTPUBEX=") + cidx + ",1,1,0,\"" + topic + "\"," + String(plength);
+  return publish(topic, payload, plength, 1, false);
+}
+
+bool AsyncMqttGSM::publish(
+    const char *topic, const uint8_t *payload, unsigned int plength, uint8_t qos, bool retain) {
+  int msgId = publishAsync(topic, payload, plength, qos, retain);
+  if (msgId < 0) return false;
+  // Nothing comes back from the broker for QoS 0
+  if (msgId == 0) return true;
+  // QoS 2 needs PUBREC and PUBCOMP before the modem reports the result
+  uint32_t timeoutMs = qos == 2 ? 2 * PUBLISH_ACK_TIMEOUT_MS : PUBLISH_ACK_TIMEOUT_MS;
+  if (!waitForPublish(msgId, timeoutMs)) {
+    log_e("Failed to get MQTT publish confirmation");
+    return false;
+  }
+  return true;
+}
+
+int AsyncMqttGSM::publishAsync(
+    const char *topic, const uint8_t *payload, unsigned int plength, uint8_t qos, bool retain) {
+  if (qos > 2) {
+    log_e("Invalid MQTT QoS %u", qos);
+    return -1;
+  }
+  // QoS 0 must use msgId 0 and is never acked by the broker, so it takes no window slot
+  int msgId = 0;
+  if (qos > 0) {
+    msgId = publishWindow.acquire(PUBLISH_ACK_TIMEOUT_MS);
+    if (msgId < 0) return -1;
+  }
+
+  // Client, msgId, qos, retain
+  String cmd = String("AT+QMTPUBEX=") + cidx + "," + String(msgId) + "," + String(qos) + "," +
+               (retain ? "1" : "0") + ",\"" + topic + "\"," + String(plength);
   ATPromise *mqttPromise = ctx->at().sendCommand(cmd);
   if (!mqttPromise->expect(">")->wait()) {
     log_e("Failed to publish MQTT topic");
     ctx->at().popCompletedPromise(mqttPromise->getId());
-    return false;
+    if (msgId > 0) publishWindow.cancel(msgId);
+    return -1;
   }
-  ctx->at().popCompletedPromise(mqttPromise->getId());
 
-  // Send payload
-  String payloadStr;
-  payloadStr.reserve(plength);
-  for (unsigned int i = 0; i < plength; i++) { payloadStr += char(payload[i]); }
-  mqttPromise = ctx->at().sendCommand(payloadStr);
-  if (!mqttPromise->wait()) {
+  // The modem reads exactly plength bytes, so the payload goes out as-is: no String staging,
+  // no line terminator, and NUL or CR/LF bytes are passed through
+  ctx->at().getStream()->write(payload, plength);
+  ctx->at().getStream()->flush();
+
+  bool accepted = mqttPromise->expect("OK")->wait();
+  ctx->at().popCompletedPromise(mqttPromise->getId());
+  if (!accepted) {
     log_e("Failed to publish MQTT payload");
-    ctx->at().popCompletedPromise(mqttPromise->getId());
-    return false;
+    if (msgId > 0) publishWindow.cancel(msgId);
+    return -1;
   }
-  ctx->at().popCompletedPromise(mqttPromise->getId());
 
-  mqttPromise = ctx->at().sendCommand("");
-  if (!mqttPromise->expect(String("+QMTPUBEX: ") + cidx)->wait() ||
-      !mqttPromise->getResponse()->containsResponse(String("+QMTPUBEX: ") + cidx + ",1,0")) {
-    log_e("Failed to get MQTT publish confirmation");
-    ctx->at().popCompletedPromise(mqttPromise->getId());
-    return false;
+  // For QoS 1 and 2 the +QMTPUBEX URC completes the message in publishWindow
+  return msgId;
+}
+
+bool AsyncMqttGSM::waitForPublish(int msgId, uint32_t timeoutMs) {
+  if (msgId == 0) return true;
+  if (msgId < 0 || msgId > 0xFFFF) return false;
+  return publishWindow.wait(static_cast<uint16_t>(msgId), timeoutMs);
+}
+
+size_t AsyncMqttGSM::publishBatch(MqttBatchMessage *messages, size_t count) {
+  const unsigned long start = millis();
+  size_t delivered = 0;
+  std::deque<PendingAck> outstanding;
+  auto record = [&](const PendingAck &ack, bool ok) {
+    messages[ack.first].ok = ok;
+    if (ok) delivered++;
+  };
+
+  for (size_t i = 0; i < count; i++) {
+    MqttBatchMessage &msg = messages[i];
+    msg.ok = false;
+    if (outstanding.size() >= publishWindow.window()) collectOldest(outstanding, record);
+    int msgId = publishAsync(msg.topic, msg.payload, msg.length, msg.qos, msg.retain);
+    if (msgId < 0) {
+      if (ctx->modem().URCState.mqttState.load() == MqttConnectionState::DISCONNECTED) {
+        log_e("MQTT connection lost, abandoning batch at message %zu", i);
+        break;
+      }
+      continue;
+    }
+    if (msgId == 0) {
+      msg.ok = true;
+      delivered++;
+      continue;
+    }
+    // The same allowance publish() waits with
+    uint32_t timeoutMs = msg.qos == 2 ? 2 * PUBLISH_ACK_TIMEOUT_MS : PUBLISH_ACK_TIMEOUT_MS;
+    outstanding.push_back({i, 1, static_cast<uint16_t>(msgId), timeoutMs});
   }
-  ctx->at().popCompletedPromise(mqttPromise->getId());
+  while (!outstanding.empty()) collectOldest(outstanding, record);
 
-  return true;
+  batchMs = static_cast<uint32_t>(millis() - start);
+  log_d("Published %zu/%zu messages in %u ms", delivered, count, static_cast<unsigned>(batchMs));
+  return delivered;
+}
+
+void AsyncMqttGSM::collectOldest(std::deque<PendingAck> &outstanding, const AckResult &onResult) {
+  PendingAck oldest = outstanding.front();
+  outstanding.pop_front();
+  onResult(oldest, publishWindow.wait(oldest.msgId, oldest.timeoutMs));
 }
 
 bool AsyncMqttGSM::subscribe(const char *topic) { return subscribe(topic, 0); }
 
 bool AsyncMqttGSM::subscribe(const char *topic, uint8_t qos) {
-  subscribedTopics.insert(topic);
-  // Client: 0, msgId: 1, topic, qos
-  String cmd = String("AT+QMTSUB=") + cidx + ",1,\"" + topic + "\"," + String(qos);
-  ATPromise *mqttPromise = ctx->at().sendCommand(cmd);
-  if (!mqttPromise->wait()) {
-    log_e("Failed to subscribe MQTT topic");
-    ctx->at().popCompletedPromise(mqttPromise->getId());
+  if (qos > 2) {
+    log_e("Invalid MQTT QoS %u", qos);
     return false;
   }
-  ctx->at().popCompletedPromise(mqttPromise->getId());
+  // Remembered up front so a failed subscription is retried on reconnect
+  auto it = std::find_if(subscriptions.begin(), subscriptions.end(), [topic](const auto &sub) {
+    return sub.topic == topic;
+  });
+  if (it == subscriptions.end()) {
+    subscriptions.push_back({topic, qos});
+  } else {
+    it->qos = qos;
+  }
+  MqttSubscription sub{topic, qos};
+  return subscribeAll(&sub, 1);
+}
 
-  mqttPromise = ctx->at().sendCommand("");
-  if (!mqttPromise->expect(String("+QMTSUB: ") + cidx + ",1,0")->wait()) {
-    log_e("Failed to get MQTT subscribe confirmctx->ation");
-    ctx->at().popCompletedPromise(mqttPromise->getId());
-    return false;
+int AsyncMqttGSM::sendSubscribe(const MqttSubscription *subs, size_t count) {
+  // Subscribe requests share the packet identifiers and ack tracking of publishes
+  int msgId = publishWindow.acquire(PUBLISH_ACK_TIMEOUT_MS);
+  if (msgId < 0) return -1;
+
+  // Client, msgId, then topic and qos for each filter
+  String cmd = String("AT+QMTSUB=") + cidx + "," + String(msgId);
+  for (size_t i = 0; i < count; i++) {
+    cmd += ",\"" + subs[i].topic + "\"," + String(subs[i].qos);
   }
+  ATPromise *mqttPromise = ctx->at().sendCommand(cmd);
+  bool accepted = mqttPromise->wait();
   ctx->at().popCompletedPromise(mqttPromise->getId());
-  return true;
+  if (!accepted) {
+    log_w("Modem rejected AT+QMTSUB for %zu topics", count);
+    publishWindow.cancel(msgId);
+    return -1;
+  }
+  // The +QMTSUB URC completes the request in publishWindow
+  return msgId;
+}
+
+bool AsyncMqttGSM::subscribeAll(const MqttSubscription *subs, size_t count) {
+  bool ok = true;
+  std::deque<PendingAck> outstanding;
+  // Filters of failed batches, retried one by one at the end
+  std::vector<size_t> retry;
+  auto failBatch = [&](size_t first, size_t n) {
+    if (n == 1) {
+      log_e("Failed to subscribe MQTT topic %s", subs[first].topic.c_str());
+      ok = false;
+      return;
+    }
+    for (size_t k = 0; k < n; k++) retry.push_back(first + k);
+  };
+  auto record = [&](const PendingAck &batch, bool acked) {
+    if (!acked) failBatch(batch.first, batch.count);
+  };
+
+  const size_t prefixLength = strlen("AT+QMTSUB=") + strlen(cidx) + 6;
+  size_t next = 0;
+  while (next < count) {
+    size_t n = 0;
+    size_t length = prefixLength;
+    while (next + n < count && n < SUBSCRIBE_BATCH_TOPICS) {
+      // ,"<topic>",<qos>
+      size_t entry = subs[next + n].topic.length() + 5;
+      if (n > 0 && length + entry > SUBSCRIBE_BATCH_CHARS) break;
+      length += entry;
+      n++;
+    }
+
+    if (outstanding.size() >= publishWindow.window()) collectOldest(outstanding, record);
+    int msgId = sendSubscribe(subs + next, n);
+    if (msgId < 0) {
+      if (ctx->modem().URCState.mqttState.load() == MqttConnectionState::DISCONNECTED) {
+        log_e("MQTT connection lost while subscribing");
+        ok = false;
+        break;
+      }
+      failBatch(next, n);
+    } else {
+      outstanding.push_back({next, n, static_cast<uint16_t>(msgId), PUBLISH_ACK_TIMEOUT_MS});
+    }
+    next += n;
+  }
+  while (!outstanding.empty()) collectOldest(outstanding, record);
+
+  // Modems without multi-topic support reject the whole command, and a broker refusing one
+  // filter fails its batch; either way the single-topic form sorts out which ones work
+  for (size_t i : retry) {
+    if (ctx->modem().URCState.mqttState.load() == MqttConnectionState::DISCONNECTED) {
+      ok = false;
+      break;
+    }
+    int msgId = sendSubscribe(subs + i, 1);
+    if (msgId < 0 || !publishWindow.wait(static_cast<uint16_t>(msgId), PUBLISH_ACK_TIMEOUT_MS)) {
+      log_e("Failed to subscribe MQTT topic %s", subs[i].topic.c_str());
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool AsyncMqttGSM::subscribe(const char *filter, uint8_t qos, MqttTopicHandler handler) {
+  // Route before subscribing so retained messages sent right after the SUBACK find the handler.
+  // Like the plain overload, a failed subscription stays registered and is retried on reconnect.
+  if (!router.add(filter, std::move(handler))) { return false; }
+  return subscribe(filter, qos);
 }
 
 bool AsyncMqttGSM::unsubscribe(const char *topic) {
-  String cmd = String("AT+QMTUNSUB=") + cidx + ",1,\"" + topic + "\"";
+  // Forget the topic up front so a failed UNSUBACK does not bring it back on reconnect
+  router.remove(topic);
+  subscriptions.erase(
+      std::remove_if(
+          subscriptions.begin(), subscriptions.end(),
+          [topic](const auto &sub) { return sub.topic == topic; }),
+      subscriptions.end());
+
+  // Takes its packet identifier from the window like subscribe requests, so it never collides
+  // with one still in flight
+  int msgId = publishWindow.acquire(PUBLISH_ACK_TIMEOUT_MS);
+  if (msgId < 0) return false;
+
+  String cmd = String("AT+QMTUNSUB=") + cidx + "," + String(msgId) + ",\"" + topic + "\"";
   ATPromise *mqttPromise = ctx->at().sendCommand(cmd);
-  if (!mqttPromise->wait()) {
+  bool accepted = mqttPromise->wait();
+  ctx->at().popCompletedPromise(mqttPromise->getId());
+  if (!accepted) {
     log_e("Failed to unsubscribe MQTT topic");
-    ctx->at().popCompletedPromise(mqttPromise->getId());
+    publishWindow.cancel(msgId);
     return false;
   }
-  ctx->at().popCompletedPromise(mqttPromise->getId());
 
-  mqttPromise = ctx->at().sendCommand("");
-  if (!mqttPromise->expect(String("+QMTUNSUB: ") + cidx + ",1,0")->wait()) {
-    log_e("Failed to get MQTT unsubscribe confirmctx->ation");
-    ctx->at().popCompletedPromise(mqttPromise->getId());
+  // The +QMTUNSUB URC completes the request in publishWindow
+  if (!publishWindow.wait(static_cast<uint16_t>(msgId), PUBLISH_ACK_TIMEOUT_MS)) {
+    log_e("Failed to get MQTT unsubscribe confirmation");
     return false;
   }
-  ctx->at().popCompletedPromise(mqttPromise->getId());
   return true;
 }
 
@@ -205,10 +391,26 @@ AsyncMqttGSM &AsyncMqttGSM::setCallback(AsyncMqttGSMCallback callback) {
   return *this;
 }
 
+bool AsyncMqttGSM::setReceiveQueue(
+    size_t capacity, MqttOverflowPolicy policy, size_t payloadReserve) {
+  // The dispatch task would consume from the ring while it is rebuilt
+  if (dispatchTask) {
+    log_e("Stop the MQTT dispatch task before changing the receive queue");
+    return false;
+  }
+  // Detaching waits out a push in progress; the URC handler drops messages until it is back
+  AsyncEG915U &modem = ctx->modem();
+  bool attached = modem.mqttQueueSub == &mqttQueueSub;
+  if (attached) modem.setMqttQueue(nullptr);
+  bool ok = mqttQueueSub.configure(capacity, policy, payloadReserve);
+  if (attached) modem.setMqttQueue(&mqttQueueSub);
+  return ok;
+}
+
 void AsyncMqttGSM::loop() {
   if (ctx->modem().URCState.mqttState.load() == MqttConnectionState::IDLE) { return; }
 
-  if (!mqttCallback) { return; }
+  if (!mqttCallback && router.size() == 0) { return; }
 
   if (ctx->modem().URCState.mqttState.load() == MqttConnectionState::DISCONNECTED) {
     if (!reconnect()) {
@@ -217,28 +419,85 @@ void AsyncMqttGSM::loop() {
     }
   }
 
-  if (!ctx->modem().mqttQueueSub) { return; }
-  if (ctx->modem().mqttQueueSub->size() == 0) { return; }
+  if (dispatchRunning.load()) { return; }
+  fetchBuffered();
+  if (mqttQueueSub.size() == 0) { return; }
+
+  dispatchPending();
+}
+
+size_t AsyncMqttGSM::dispatchPending() {
+  size_t delivered = 0;
+  // Handlers see the message where it sits in the queue; the slot is freed afterwards
+  auto deliver = [this](MqttMessage &msg) {
+    char *topic = (char *)msg.topic.c_str();
+    if (router.dispatch(topic, msg.payload.data(), msg.length) > 0) { return; }
+    if (mqttCallback) { mqttCallback(topic, msg.payload.data(), msg.length); }
+  };
+  while (mqttQueueSub.consume(deliver)) { delivered++; }
+  return delivered;
+}
+
+void AsyncMqttGSM::fetchBuffered() {
+  const uint8_t client = static_cast<uint8_t>(atoi(cidx));
+  while (ctx->modem().fetchMqttMessage(client)) { dispatchPending(); }
+}
+
+bool AsyncMqttGSM::startDispatchTask(UBaseType_t priority, uint32_t stackSize) {
+  if (dispatchTask) return true;
+  dispatchRunning.store(true);
+  if (xTaskCreate(dispatchTaskEntry, "MQTT_DISPATCH", stackSize, this, priority, &dispatchTask) !=
+      pdPASS) {
+    log_e("Failed to create MQTT dispatch task");
+    dispatchRunning.store(false);
+    dispatchTask = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void AsyncMqttGSM::stopDispatchTask() {
+  if (!dispatchTask) return;
+  dispatchRunning.store(false);
+  mqttQueueSub.wake();
+  // The task uses this object until it signals, so a slow handler is waited out
+  if (xSemaphoreTake(dispatchStopped, pdMS_TO_TICKS(1000)) != pdTRUE) {
+    log_w("MQTT dispatch task still in a handler, waiting for it");
+    xSemaphoreTake(dispatchStopped, portMAX_DELAY);
+  }
+  dispatchTask = nullptr;
+}
 
-  MqttMessage message;
-  while (ctx->modem().mqttQueueSub->pop(message)) {
-    mqttCallback((char *)message.topic.c_str(), message.payload.data(), message.length);
+void AsyncMqttGSM::dispatchTaskEntry(void *pv) {
+  auto *self = static_cast<AsyncMqttGSM *>(pv);
+  while (self->dispatchRunning.load()) {
+    // Also woken by +QMTRECV notices of messages still in the modem's buffer
+    self->mqttQueueSub.waitForData(portMAX_DELAY);
+    self->fetchBuffered();
+    self->dispatchPending();
   }
+  xSemaphoreGive(self->dispatchStopped);
+  vTaskDelete(nullptr);
+}
+
+AsyncMqttGSM &AsyncMqttGSM::setCleanSession(bool clean) {
+  cleanSession = clean;
+  return *this;
 }
 
 bool AsyncMqttGSM::reconnect() {
   log_w("Reconnecting to MQTT server...");
+  // Only reached after +QMTSTAT closed the link, so the modem holds no connection to resume.
+  // +QMTCONN does not report CONNACK's session-present flag either, hence the resubscribe.
   if (!connect(apn, user, pass)) {
     log_e("Failed to reconnect to MQTT server");
     return false;
   }
 
-  // Resubscribe to topics
-  for (const auto &topic : subscribedTopics) {
-    if (!subscribe(topic)) {
-      log_e("Failed to resubscribe to topic: %s", topic);
-      return false;
-    }
+  // Resubscribe to every topic at its original QoS, several filters per command
+  if (!subscribeAll(subscriptions.data(), subscriptions.size())) {
+    log_e("Failed to resubscribe to MQTT topics");
+    return false;
   }
 
   log_i("Reconnected to MQTT server and resubscribed to topics.");
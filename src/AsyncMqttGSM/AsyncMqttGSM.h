@@ -2,27 +2,77 @@
 
 #include <GSMContext/GSMContext.h>
 #include <modules/EG915/EG915.h>
+#include <utils/MqttTopicRouter/MqttTopicRouter.h>
 
-#include <set>
+#include <deque>
+#include <vector>
 
 using AsyncMqttGSMCallback = std::function<void(char *, uint8_t *, unsigned int)>;
 
+// One entry of publishBatch(); ok is filled in with the outcome
+struct MqttBatchMessage {
+  const char *topic;
+  const uint8_t *payload;
+  unsigned int length;
+  uint8_t qos{1};
+  bool retain{false};
+  bool ok{false};
+};
+
+// A topic filter to (re)subscribe with the QoS it was first requested at
+struct MqttSubscription {
+  String topic;
+  uint8_t qos;
+};
+
 class AsyncMqttGSM {
  private:
   AtomicMqttQueue mqttQueueSub;
+  MqttPublishWindow publishWindow;
   bool owns = false;
   GSMContext *ctx;
 
   AsyncMqttGSMCallback mqttCallback = nullptr;
+  MqttTopicRouter router;
 
   const char *domain;
   uint16_t port;
   const char *apn;
   const char *user;
   const char *pass;
-  std::set<const char *> subscribedTopics;
+  std::vector<MqttSubscription> subscriptions;
+  uint32_t batchMs{0};
+  bool cleanSession{false};
 
   bool reconnect();
+  // Sends one AT+QMTSUB covering count filters and returns its msgId, or -1
+  int sendSubscribe(const MqttSubscription *subs, size_t count);
+  // Subscribes in as few AT+QMTSUB commands as the modem allows, keeping several in flight, and
+  // retries the filters of a failed batch one at a time
+  bool subscribeAll(const MqttSubscription *subs, size_t count);
+  // A batch request handed to the modem whose ack is still unread: count entries from first
+  struct PendingAck {
+    size_t first;
+    size_t count;
+    uint16_t msgId;
+    uint32_t timeoutMs;
+  };
+  using AckResult = std::function<void(const PendingAck &, bool)>;
+  // Waits for the oldest request's ack, drops it from outstanding and hands onResult whether
+  // the broker took it. Reading results as the window fills keeps them from being recycled
+  // unread.
+  void collectOldest(std::deque<PendingAck> &outstanding, const AckResult &onResult);
+
+  TaskHandle_t dispatchTask{nullptr};
+  std::atomic<bool> dispatchRunning{false};
+  SemaphoreHandle_t dispatchStopped = xSemaphoreCreateBinary();
+  static void dispatchTaskEntry(void *pv);
+  // Routes every queued message in place to the handlers whose filter matches, or to the
+  // callback when none does; returns how many messages were consumed
+  size_t dispatchPending();
+  // Fetches the messages the modem announced but kept in its buffer, one at a time so each is
+  // dispatched before the next one needs a slot in the queue
+  void fetchBuffered();
 
  public:
   AsyncMqttGSM(GSMContext &context);
@@ -35,15 +85,58 @@ class AsyncMqttGSM {
 
   AsyncMqttGSM &setServer(const char *domain, uint16_t port);
   uint8_t connected();
+  // Off by default: the broker keeps subscriptions across connections. Call before init().
+  AsyncMqttGSM &setCleanSession(bool clean);
   virtual bool connect(const char *id, const char *user, const char *pass);
+  // QoS 1, not retained
   virtual bool publish(const char *topic, const uint8_t *payload, unsigned int plength);
+  // QoS 0 returns once the modem took the payload; QoS 1 waits for PUBACK and QoS 2 for PUBCOMP
+  bool publish(
+      const char *topic, const uint8_t *payload, unsigned int plength, uint8_t qos, bool retain);
+  // Hands the message to the modem and returns its msgId without waiting for the broker's ack,
+  // or -1 on failure. QoS 0 messages are untracked and return 0. Blocks only while the publish
+  // window is full.
+  int publishAsync(
+      const char *topic, const uint8_t *payload, unsigned int plength, uint8_t qos = 1,
+      bool retain = false);
+  bool waitForPublish(int msgId, uint32_t timeoutMs = PUBLISH_ACK_TIMEOUT_MS);
+  // Publishes count messages keeping the window full and collects every ack before returning.
+  // Returns the number of messages that made it; see lastBatchMs() for the time taken.
+  size_t publishBatch(MqttBatchMessage *messages, size_t count);
+  uint32_t lastBatchMs() const { return batchMs; }
+  // Number of QoS 1/2 publishes and subscribe requests allowed in flight at once, up to
+  // MqttPublishWindow::MAX_WINDOW
+  bool setPublishWindow(uint8_t size) { return publishWindow.setWindow(size); }
   virtual bool subscribe(const char *topic);
   bool subscribe(const char *topic, uint8_t qos);
+  // Subscribes to a filter that may contain '+' and '#' and delivers its messages to handler
+  // instead of the callback. A topic matching several filters reaches each of their handlers.
+  bool subscribe(const char *filter, uint8_t qos, MqttTopicHandler handler);
   bool unsubscribe(const char *topic);
+  // Receives the messages no subscription handler matched
   AsyncMqttGSM &setCallback(AsyncMqttGSMCallback callback);
+  // Depth and overflow policy of the inbound queue, with payloadReserve bytes preallocated per
+  // slot. Call before connect(); messages arriving meanwhile are dropped. Refused while the
+  // dispatch task runs.
+  bool setReceiveQueue(
+      size_t capacity, MqttOverflowPolicy policy = MqttOverflowPolicy::BLOCK,
+      size_t payloadReserve = 0);
+  uint32_t droppedMessages() const { return mqttQueueSub.dropped(); }
   void loop();
+  // Delivers messages from a task of its own as soon as they are queued; loop() then only
+  // handles reconnects. Set the callback or subscription handlers first.
+  bool startDispatchTask(UBaseType_t priority = 2, uint32_t stackSize = 4096);
+  // Returns once the task is gone, waiting for a handler still running. Not for use from one.
+  void stopDispatchTask();
 
  protected:
   const char *cidx = "1";
   virtual bool isSecure() const { return false; }
+
+  // Covers the modem's own retries: AT+QMTCFG="timeout" allows 5 s per attempt, 3 retries
+  static constexpr uint32_t PUBLISH_ACK_TIMEOUT_MS = 20000;
+  // AT+QMTSUB takes at most 5 topic filters, and long filters are split earlier to keep the
+  // command line within what the modem buffers
+  static constexpr size_t SUBSCRIBE_BATCH_TOPICS = 5;
+  static constexpr size_t SUBSCRIBE_BATCH_CHARS = 512;
 };
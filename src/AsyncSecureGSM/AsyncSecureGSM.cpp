@@ -1,48 +1,45 @@
 #include "AsyncSecureGSM.h"
 
-#include <MD5Builder.h>
-
 #include "esp_log.h"
 
-static String caMd5;
-
 AsyncSecureGSM::AsyncSecureGSM(GSMContext &context) : AsyncGSM(context) {
   // Base ctor cannot see our override; enforce SSL default here
-  ctx->transport().setDefaultSSL(true);
+  if (rx) { rx->setDefaultSSL(true); }
 }
 
 AsyncSecureGSM::AsyncSecureGSM() : AsyncGSM() {
   // Base ctor cannot see our override; enforce SSL default here
-  ctx->transport().setDefaultSSL(true);
+  if (rx) { rx->setDefaultSSL(true); }
 }
 
 bool AsyncSecureGSM::modemConnect(const char *host, uint16_t port) {
-  return ctx->modem().connectSecure(host, port);
+  if (socketId < 0) return false;
+  return ctx->modem().connectSecure(host, port, static_cast<uint8_t>(socketId));
 }
 
-bool AsyncSecureGSM::modemStop() { return ctx->modem().stopSecure(); }
+bool AsyncSecureGSM::modemStop() {
+  if (socketId < 0) return false;
+  return ctx->modem().stopSecure(static_cast<uint8_t>(socketId));
+}
+
+bool AsyncSecureGSM::installCert(EG915CertKind kind, const char *pem) {
+  if (!pem || !*pem) return false;
+  uint8_t sslCtx = static_cast<uint8_t>(String(ssl_cidx).toInt());
+  return ctx->modem().certs.install(sslCtx, kind, pem);
+}
 
 void AsyncSecureGSM::setCACert(const char *rootCA) {
-  if (!rootCA || !*rootCA) { return; }
-
-  MD5Builder md5;
-  md5.begin();
-  md5.add((uint8_t *)rootCA, strlen(rootCA));
-  md5.calculate();
-  String newMd5 = md5.toString();
-
-  if (newMd5 == caMd5) { return; }
-
-  log_d("Setting CA cert with MD5 %s", newMd5.c_str());
-  const char *filename = newMd5.c_str();
-  String foundName;
-  size_t foundSize = 0;
-  bool exists = ctx->modem().findUFSFile(filename, &foundName, &foundSize);
-  if (!exists) {
-    log_d("Uploading CA cert to UFS as %s", filename);
-    ctx->modem().uploadUFSFile(filename, reinterpret_cast<const uint8_t *>(rootCA), strlen(rootCA));
+  if (!installCert(EG915CertKind::CA_CERT, rootCA)) { log_e("Failed to set CA cert"); }
+}
+
+void AsyncSecureGSM::setCertificate(const char *clientCert) {
+  if (!installCert(EG915CertKind::CLIENT_CERT, clientCert)) {
+    log_e("Failed to set client cert");
+  }
+}
+
+void AsyncSecureGSM::setPrivateKey(const char *privateKey) {
+  if (!installCert(EG915CertKind::CLIENT_KEY, privateKey)) {
+    log_e("Failed to set client key");
   }
-  log_i("Configuring CA cert for SSL");
-  ctx->modem().setCACertificate(filename, ssl_cidx);
-  caMd5 = newMd5;
 }
@@ -7,11 +7,21 @@ class AsyncSecureGSM : public AsyncGSM {
   AsyncSecureGSM(GSMContext &context);
   AsyncSecureGSM();
 
+  // PEMs go through the modem's certificate store: uploaded to UFS once under their MD5 and
+  // reused from there
   void setCACert(const char *rootCA);
+  // Client certificate and key for mutual TLS; with both set the context verifies both ends
+  void setCertificate(const char *clientCert);
+  void setPrivateKey(const char *privateKey);
+  // TLS version, cipher suite and session resumption used by the next connect()
+  void setSslOptions(const EG915SslOptions &options) { ctx->modem().setSslOptions(options); }
 
  protected:
   const char *ssl_cidx = "1";
   bool isSecure() const override { return true; }
   bool modemConnect(const char *host, uint16_t port) override;
   bool modemStop() override;
+
+ private:
+  bool installCert(EG915CertKind kind, const char *pem);
 };
@@ -1,21 +1,21 @@
 #include "AsyncSecureMqttGSM.h"
 
-#include <MD5Builder.h>
-
 #include "esp_log.h"
 
 void AsyncSecureMqttGSM::setSecurityLevel(bool secure) {
-  auto &at = context().at();
-
-  String secureLevel = (isSecure() ? "1" : "0");
-  // Enable SSL for the MQTT client and bind to SSL context index
-  if (!at.sendSync(String("AT+QMTCFG=\"ssl\",") + cidx + "," + secureLevel + "," + ssl_cidx)) {
+  // Enable SSL for the MQTT client and bind to SSL context index. The modem driver only sends
+  // it when the setting changed, so calling this before every publish is free.
+  uint8_t client = static_cast<uint8_t>(String(cidx).toInt());
+  uint8_t sslCtx = static_cast<uint8_t>(String(ssl_cidx).toInt());
+  if (!context().modem().configureMqttSsl(client, secure, sslCtx)) {
     log_e("Failed to set SSL for MQTT");
   }
 }
 
 bool AsyncSecureMqttGSM::connect(const char *id, const char *user, const char *pass) {
   setSecurityLevel(isSecure());
+  // Points the context at its certificates again if the modem restarted since setCACert()
+  context().modem().applyCertificates(static_cast<uint8_t>(String(ssl_cidx).toInt()));
   return AsyncMqttGSM::connect(id, user, pass);
 }
 
@@ -29,25 +29,24 @@ bool AsyncSecureMqttGSM::subscribe(const char *topic) {
   return AsyncMqttGSM::subscribe(topic, 0);
 }
 
+bool AsyncSecureMqttGSM::installCert(EG915CertKind kind, const char *pem) {
+  if (!pem || !*pem) return false;
+  uint8_t sslCtx = static_cast<uint8_t>(String(ssl_cidx).toInt());
+  return context().modem().certs.install(sslCtx, kind, pem);
+}
+
 void AsyncSecureMqttGSM::setCACert(const char *rootCA) {
-  if (!rootCA || !*rootCA) { return; }
-
-  MD5Builder md5;
-  md5.begin();
-  md5.add((uint8_t *)rootCA, strlen(rootCA));
-  md5.calculate();
-  String newMd5 = md5.toString();
-  if (newMd5 == caMd5Cache) { return; }
-
-  const char *filename = newMd5.c_str();
-  String found;
-  size_t fsize = 0;
-  bool exists = context().modem().findUFSFile(filename, &found, &fsize);
-  if (!exists) {
-    context().modem().uploadUFSFile(
-        filename, reinterpret_cast<const uint8_t *>(rootCA), strlen(rootCA));
+  if (!installCert(EG915CertKind::CA_CERT, rootCA)) { log_e("Failed to set CA cert"); }
+}
+
+void AsyncSecureMqttGSM::setCertificate(const char *clientCert) {
+  if (!installCert(EG915CertKind::CLIENT_CERT, clientCert)) {
+    log_e("Failed to set client cert");
   }
+}
 
-  context().modem().setCACertificate(filename, ssl_cidx);
-  caMd5Cache = newMd5;
+void AsyncSecureMqttGSM::setPrivateKey(const char *privateKey) {
+  if (!installCert(EG915CertKind::CLIENT_KEY, privateKey)) {
+    log_e("Failed to set client key");
+  }
 }
@@ -8,15 +8,20 @@ class AsyncSecureMqttGSM : public AsyncMqttGSM {
   AsyncSecureMqttGSM(GSMContext &context) : AsyncMqttGSM(context) {}
   AsyncSecureMqttGSM() : AsyncMqttGSM() {}
 
-  // Compute MD5 filename, upload if needed, and configure QSSLCFG cacert
+  // Uploaded through the modem's certificate store, so PEMs shared with other contexts or
+  // already in UFS are not sent again
   void setCACert(const char *rootCA);
+  // Client certificate and key for mutual TLS
+  void setCertificate(const char *clientCert);
+  void setPrivateKey(const char *privateKey);
   bool connect(const char *id, const char *user, const char *pass) override;
+  using AsyncMqttGSM::publish;
   bool publish(const char *topic, const uint8_t *payload, unsigned int plength) override;
+  using AsyncMqttGSM::subscribe;
   bool subscribe(const char *topic) override;
 
  private:
-  String caMd5Cache;
-
+  bool installCert(EG915CertKind kind, const char *pem);
   void setSecurityLevel(bool secure);
 
  protected:
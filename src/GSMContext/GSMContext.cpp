@@ -2,7 +2,49 @@
 
 #include "esp_log.h"
 
-GSMContext::GSMContext() { rxMutex = xSemaphoreCreateMutex(); }
+GSMContext::GSMContext() {
+  rxMutex = xSemaphoreCreateMutex();
+  socketMutex = xSemaphoreCreateMutex();
+  transports[0].reset(new GSMTransport());
+}
+
+GSMTransport &GSMContext::transport(uint8_t socketId) {
+  if (socketId >= EG915_MAX_SOCKETS) {
+    log_e("Invalid socket %u, using socket 0", socketId);
+    socketId = 0;
+  }
+  xSemaphoreTake(socketMutex, portMAX_DELAY);
+  if (!transports[socketId]) {
+    transports[socketId].reset(new GSMTransport());
+    if (ioStream) { attachTransport(socketId); }
+  }
+  GSMTransport &t = *transports[socketId];
+  xSemaphoreGive(socketMutex);
+  return t;
+}
+
+void GSMContext::attachTransport(uint8_t socketId) {
+  transports[socketId]->init(*ioStream, rxMutex, socketId, &modemDriver);
+  modemDriver.attachTransport(socketId, transports[socketId].get());
+}
+
+int GSMContext::acquireSocket() {
+  uint16_t used = socketsInUse.load();
+  for (;;) {
+    int id = 0;
+    while (id < EG915_MAX_SOCKETS && (used & (1u << id))) { id++; }
+    if (id == EG915_MAX_SOCKETS) {
+      log_e("No free sockets left");
+      return -1;
+    }
+    if (socketsInUse.compare_exchange_weak(used, used | (1u << id))) { return id; }
+  }
+}
+
+void GSMContext::releaseSocket(int socketId) {
+  if (socketId < 0 || socketId >= EG915_MAX_SOCKETS) return;
+  socketsInUse.fetch_and(static_cast<uint16_t>(~(1u << socketId)));
+}
 
 bool GSMContext::begin(Stream &stream, EG915SimSlot simSlot) {
   this->simSlot = simSlot;
@@ -11,12 +53,41 @@ bool GSMContext::begin(Stream &stream, EG915SimSlot simSlot) {
     log_e("Failed to initialize AsyncATHandler");
     return false;
   }
-  rxTransport.init(stream, rxMutex);
-  modemDriver.init(stream, atHandler, rxTransport);
+  modemDriver.init(stream, atHandler);
+  xSemaphoreTake(socketMutex, portMAX_DELAY);
+  for (uint8_t id = 0; id < EG915_MAX_SOCKETS; ++id) {
+    if (transports[id]) { attachTransport(id); }
+  }
+  xSemaphoreGive(socketMutex);
   return true;
 }
 
-bool GSMContext::setupNetwork(const char *apn) {
+static bool isRegistered(RegStatus status) {
+  return status == RegStatus::REG_OK_HOME || status == RegStatus::REG_OK_ROAMING;
+}
+
+bool GSMContext::setupNetwork(const char *apn, GSMStartMode mode) {
+  timing = GSMBringUpTiming();
+  const unsigned long start = millis();
+  unsigned long stageStart = start;
+  // Closes the current stage and returns its duration
+  auto lap = [&stageStart]() {
+    unsigned long now = millis();
+    uint32_t elapsed = static_cast<uint32_t>(now - stageStart);
+    stageStart = now;
+    return elapsed;
+  };
+  auto finish = [&](bool ok) {
+    timing.totalMs = static_cast<uint32_t>(millis() - start);
+    log_i(
+        "Bring-up %s in %u ms (probe %u, config %u, sim %u, reg %u, pdp %u)",
+        ok ? "done" : "failed", static_cast<unsigned>(timing.totalMs),
+        static_cast<unsigned>(timing.probeMs), static_cast<unsigned>(timing.configMs),
+        static_cast<unsigned>(timing.simMs), static_cast<unsigned>(timing.registrationMs),
+        static_cast<unsigned>(timing.pdpMs));
+    return ok;
+  };
+
   bool canCommunicate = false;
   for (int i = 0; i < 4; i++) {
     if (atHandler.sendSync("AT", 2000)) {
@@ -24,46 +95,71 @@ bool GSMContext::setupNetwork(const char *apn) {
       break;
     }
   }
+  timing.probeMs = lap();
   if (!canCommunicate) {
     log_e("Failed to communicate with modem");
-    return false;
+    return finish(false);
+  }
+
+  if (mode == GSMStartMode::WARM) {
+    // After an MCU-only reset the modem keeps its configuration, registration and PDP context
+    EG915NetworkSnapshot snap;
+    bool reusable = modemDriver.queryNetworkSnapshot(snap) && snap.simReady &&
+                    snap.simSlot == simSlot && isRegistered(snap.creg);
+    timing.configMs = lap();
+    if (reusable) {
+      // Sockets left open by the previous session would collide with new connectIDs
+      modemDriver.closeSockets(snap.openSockets, snap.openSslSockets);
+      bool ok = snap.pdpActive && snap.apn == apn;
+      if (ok) {
+        log_i("Warm start: reusing active PDP context");
+      } else {
+        ok = activateData(apn);
+      }
+      timing.pdpMs = lap();
+      return finish(ok);
+    }
+    log_i("Warm start not possible, running full bring-up");
   }
 
-  if (!modemDriver.setEchoOff()) return false;
-  if (!modemDriver.enableVerboseErrors()) return false;
-  if (!modemDriver.checkModemModel()) return false;
-  if (!modemDriver.checkTimezone()) return false;
-  if (!modemDriver.setSIMSlot(simSlot)) return false;
-
-  bool simReady = false;
-  uint8_t retries = 0;
-  do {
-    log_w("Waiting for SIM card...");
-    delay(1000);
-    simReady = modemDriver.checkSIMReady();
-    retries++;
-  } while (!simReady && retries < 10);
+  // Independent settings go out chained so each group costs a single round trip
+  if (!modemDriver.configureModem()) return finish(false);
+  if (!modemDriver.checkModemModel()) return finish(false);
+  if (!modemDriver.setSIMSlot(simSlot)) return finish(false);
+  modemDriver.enableNetworkURCs();
+  timing.configMs = lap();
 
+  bool simReady = modemDriver.waitForSIMReady(SIM_READY_TIMEOUT_MS);
+  timing.simMs = lap();
   if (!simReady) {
     log_e("SIM card not ready");
-    return false;
+    return finish(false);
   }
-
   log_d("SIM card is ready.");
 
+  bool registered = modemDriver.waitForRegistration(EG915_REGISTRATION_TIMEOUT_MS);
+  timing.registrationMs = lap();
+  if (!registered) return finish(false);
+
   modemDriver.disableConnections();
-  modemDriver.disalbeSleepMode();
+  bool attached = activateData(apn);
+  timing.pdpMs = lap();
+  return finish(attached);
+}
 
+bool GSMContext::activateData(const char *apn) {
   if (!modemDriver.gprsConnect(apn)) return false;
 
-  for (int i = 0; i < 10; ++i) {
+  // Attach usually completes with the activation; +CGEV wakes us early if it lags behind
+  const unsigned long attachStart = millis();
+  while (true) {
     if (modemDriver.isGPRSSAttached() && modemDriver.checkNetworkContext()) {
       log_d("GPRS is attached.");
       return true;
     }
-    delay(500);
+    if (millis() - attachStart >= ATTACH_TIMEOUT_MS) return false;
+    modemDriver.waitForEvent(500);
   }
-  return false;
 }
 
 void GSMContext::end() {
@@ -6,26 +6,59 @@
 #include <modules/EG915/EG915.h>
 #include <utils/GSMTransport/GSMTransport.h>
 
+#include <atomic>
+#include <memory>
+
 static constexpr EG915SimSlot DEFAULT_SIM_SLOT = EG915SimSlot::SLOT_1;
 
+enum class GSMStartMode {
+  COLD,  // Full configuration and bring-up
+  WARM,  // Query the modem first and reuse registration and an active PDP context
+};
+
+// Milliseconds spent in each setupNetwork() stage during the last call
+struct GSMBringUpTiming {
+  uint32_t probeMs{0};         // First AT answered
+  uint32_t configMs{0};        // Configuration, or the state query of a warm start
+  uint32_t simMs{0};           // Until +CPIN: READY
+  uint32_t registrationMs{0};  // Until +CREG/+CEREG home or roaming
+  uint32_t pdpMs{0};           // PDP context, attach and activation
+  uint32_t totalMs{0};
+};
+
 class GSMContext {
  public:
   GSMContext();
 
   bool begin(Stream &stream, EG915SimSlot simSlot = DEFAULT_SIM_SLOT);
-  bool setupNetwork(const char *apn);
+  bool setupNetwork(const char *apn, GSMStartMode mode = GSMStartMode::COLD);
   void end();
+  const GSMBringUpTiming &bringUpTiming() const { return timing; }
 
   AsyncATHandler &at() { return atHandler; }
   AsyncEG915U &modem() { return modemDriver; }
-  GSMTransport &transport() { return rxTransport; }
+  // Receive path of one connectID; created on first use so idle sockets hold no buffer
+  GSMTransport &transport(uint8_t socketId = 0);
   Stream *stream() { return ioStream; }
 
+  // Hands out the lowest free connectID, or -1 when all EG915_MAX_SOCKETS are taken
+  int acquireSocket();
+  void releaseSocket(int socketId);
+
  private:
+  void attachTransport(uint8_t socketId);
+  bool activateData(const char *apn);
+
   SemaphoreHandle_t rxMutex;
-  GSMTransport rxTransport;
+  SemaphoreHandle_t socketMutex;
+  std::unique_ptr<GSMTransport> transports[EG915_MAX_SOCKETS];
+  std::atomic<uint16_t> socketsInUse{0};
   AsyncATHandler atHandler;
   AsyncEG915U modemDriver;
   Stream *ioStream{nullptr};
   EG915SimSlot simSlot{DEFAULT_SIM_SLOT};
+  GSMBringUpTiming timing;
+
+  static constexpr uint32_t SIM_READY_TIMEOUT_MS = 10000;
+  static constexpr uint32_t ATTACH_TIMEOUT_MS = 5000;
 };
@@ -0,0 +1,116 @@
+#include "CertStore.h"
+
+#include <MD5Builder.h>
+#include <modules/EG915/EG915.h>
+
+#include "esp_log.h"
+
+void EG915CertStore::init(AsyncEG915U &owner, AsyncATHandler &handler) {
+  modem = &owner;
+  at = &handler;
+  files.clear();
+  listed = false;
+}
+
+String EG915CertStore::nameFor(const uint8_t *data, size_t size) {
+  MD5Builder md5;
+  md5.begin();
+  md5.add(const_cast<uint8_t *>(data), size);
+  md5.calculate();
+  return md5.toString();
+}
+
+bool EG915CertStore::isStoreName(const String &name) {
+  if (name.length() != 32) return false;
+  for (unsigned int i = 0; i < name.length(); i++) {
+    char c = name.charAt(i);
+    if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+  }
+  return true;
+}
+
+bool EG915CertStore::list() {
+  String resp;
+  if (!at->sendSync("AT+QFLST=\"*\"", resp)) {
+    log_e("Failed to list UFS files");
+    return false;
+  }
+  // One +QFLST: "<name>",<size> line per file
+  files.clear();
+  const char *prefix = "+QFLST: \"";
+  for (int pos = resp.indexOf(prefix); pos >= 0; pos = resp.indexOf(prefix, pos + 1)) {
+    int start = pos + strlen(prefix);
+    int end = resp.indexOf('"', start);
+    if (end < 0) break;
+    files.push_back(resp.substring(start, end));
+  }
+  listed = true;
+  log_d("UFS holds %u files", static_cast<unsigned>(files.size()));
+  return true;
+}
+
+bool EG915CertStore::has(const String &name) const {
+  for (const String &file : files) {
+    if (file == name) return true;
+  }
+  return false;
+}
+
+bool EG915CertStore::referenced(const String &name) const {
+  for (uint8_t ctx = 0; ctx < EG915_SSL_CONTEXTS; ctx++) {
+    for (size_t kind = 0; kind < EG915_CERT_KINDS; kind++) {
+      if (modem->certificatePath(ctx, static_cast<EG915CertKind>(kind)) == name) return true;
+    }
+  }
+  return false;
+}
+
+bool EG915CertStore::install(
+    uint8_t sslCtx, EG915CertKind kind, const uint8_t *data, size_t size) {
+  if (!modem || !data || size == 0 || sslCtx >= EG915_SSL_CONTEXTS) {
+    log_e("Invalid params for certificate install");
+    return false;
+  }
+  String name = nameFor(data, size);
+  if (!listed && !list()) return false;
+
+  if (!has(name)) {
+    log_d("Uploading certificate to UFS as %s", name.c_str());
+    if (!modem->uploadUFSFile(name.c_str(), data, size)) {
+      // UFS may have changed behind our back; read it again next time
+      listed = false;
+      return false;
+    }
+    files.push_back(name);
+  }
+  return modem->setCertificate(sslCtx, kind, name.c_str());
+}
+
+bool EG915CertStore::install(uint8_t sslCtx, EG915CertKind kind, const char *pem) {
+  if (!pem || !*pem) return false;
+  return install(sslCtx, kind, reinterpret_cast<const uint8_t *>(pem), strlen(pem));
+}
+
+void EG915CertStore::release(uint8_t sslCtx, EG915CertKind kind) {
+  if (modem) modem->setCertificate(sslCtx, kind, nullptr);
+}
+
+int EG915CertStore::collectGarbage() {
+  if (!modem || (!listed && !list())) return -1;
+  int deleted = 0;
+  for (auto it = files.begin(); it != files.end();) {
+    if (!isStoreName(*it) || referenced(*it)) {
+      ++it;
+      continue;
+    }
+    if (!at->sendSync(String("AT+QFDEL=\"") + *it + "\"")) {
+      log_w("Failed to delete %s from UFS", it->c_str());
+      ++it;
+      continue;
+    }
+    log_d("Deleted unreferenced certificate %s", it->c_str());
+    it = files.erase(it);
+    deleted++;
+  }
+  return deleted;
+}
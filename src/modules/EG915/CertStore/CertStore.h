@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+#include <AsyncATHandler.h>
+
+#include <vector>
+
+class AsyncEG915U;
+
+// Certificate files an SSL context can point at, in AT+QSSLCFG's own terms
+enum class EG915CertKind : uint8_t {
+  CA_CERT = 0,      // "cacert"
+  CLIENT_CERT = 1,  // "clientcert"
+  CLIENT_KEY = 2,   // "clientkey"
+};
+constexpr size_t EG915_CERT_KINDS = 3;
+
+// Content-addressed certificate files in UFS shared by every SSL context. Each file is named
+// after the MD5 of its contents, so a PEM is uploaded once no matter how many contexts use it or
+// how often the firmware restarts.
+class EG915CertStore {
+ public:
+  EG915CertStore() = default;
+
+  void init(AsyncEG915U &modem, AsyncATHandler &handler);
+
+  // Points kind of sslCtx at data, uploading it only when UFS does not hold it yet. The UFS
+  // listing is read once with AT+QFLST="*" and then kept up to date locally.
+  bool install(uint8_t sslCtx, EG915CertKind kind, const uint8_t *data, size_t size);
+  bool install(uint8_t sslCtx, EG915CertKind kind, const char *pem);
+  // Drops the reference so collectGarbage() may delete the file
+  void release(uint8_t sslCtx, EG915CertKind kind);
+  // Deletes stored files no SSL context references and returns how many went, or -1 on error.
+  // Run it once every context is installed, or files of contexts set up later get uploaded again.
+  int collectGarbage();
+  // Reads the UFS listing again on the next install, e.g. after other code changed UFS
+  void invalidate() { listed = false; }
+
+  // UFS name of data: its MD5 as 32 lowercase hex characters
+  static String nameFor(const uint8_t *data, size_t size);
+  // True for names nameFor() could have produced; only those are ever garbage collected
+  static bool isStoreName(const String &name);
+
+ private:
+  AsyncEG915U *modem{nullptr};
+  AsyncATHandler *at{nullptr};
+  std::vector<String> files;
+  bool listed{false};
+
+  bool list();
+  bool has(const String &name) const;
+  bool referenced(const String &name) const;
+};
@@ -2,59 +2,282 @@
 
 #include <utils/GSMTransport/GSMTransport.h>
 
+#include <algorithm>
+
 #include "esp_log.h"
 
-AsyncEG915U::AsyncEG915U() {}
+AsyncEG915U::AsyncEG915U() { invalidateConfigCache(); }
 
-AsyncEG915U::~AsyncEG915U() {}
+AsyncEG915U::~AsyncEG915U() {
+  if (readMutex) {
+    vSemaphoreDelete(readMutex);
+    readMutex = nullptr;
+  }
+  if (urcSignal) {
+    vSemaphoreDelete(urcSignal);
+    urcSignal = nullptr;
+  }
+  if (fileReadMutex) {
+    vSemaphoreDelete(fileReadMutex);
+    fileReadMutex = nullptr;
+  }
+  if (fileBufMutex) {
+    vSemaphoreDelete(fileBufMutex);
+    fileBufMutex = nullptr;
+  }
+  if (mqttQueueMutex) {
+    vSemaphoreDelete(mqttQueueMutex);
+    mqttQueueMutex = nullptr;
+  }
+  if (mqttFetchMutex) {
+    vSemaphoreDelete(mqttFetchMutex);
+    mqttFetchMutex = nullptr;
+  }
+}
 
-bool AsyncEG915U::init(Stream &stream, AsyncATHandler &atHandler, GSMTransport &transportRef) {
+bool AsyncEG915U::init(Stream &stream, AsyncATHandler &atHandler) {
   at = &atHandler;
   _stream = &stream;
-  transport = &transportRef;
   // Register dynamic URC handlers
   registerURCs();
   // Initialize submodules
   sim.init(atHandler);
+  certs.init(*this, atHandler);
   return true;
 }
 
+void AsyncEG915U::attachTransport(uint8_t connectId, GSMTransport *transport) {
+  if (connectId >= EG915_MAX_SOCKETS) {
+    log_e("Invalid connectID %u", connectId);
+    return;
+  }
+  transports[connectId] = transport;
+}
+
+void AsyncEG915U::setMqttQueue(AtomicMqttQueue *queue) {
+  xSemaphoreTake(mqttQueueMutex, portMAX_DELAY);
+  mqttQueueSub = queue;
+  xSemaphoreGive(mqttQueueMutex);
+}
+
+GSMTransport *AsyncEG915U::transportFor(int connectId) {
+  if (connectId < 0 || connectId >= EG915_MAX_SOCKETS) return nullptr;
+  return transports[connectId];
+}
+
+void AsyncEG915U::requestRead(uint8_t connectId, bool ssl, size_t len) {
+  if (!at) return;
+  char cmd[32];
+  if (ssl) {
+    snprintf(cmd, sizeof(cmd), "AT+QSSLRECV=%u,%u", connectId, static_cast<unsigned>(len));
+  } else {
+    snprintf(cmd, sizeof(cmd), "AT+QIRD=%u,%u", connectId, static_cast<unsigned>(len));
+  }
+  // Queue and send under one lock so the FIFO order matches the order on the wire. The promise
+  // tells a reply-less ERROR apart from a reply that is still coming.
+  xSemaphoreTake(readMutex, portMAX_DELAY);
+  uint16_t failed = reapPendingReadsLocked();
+  ATPromise *promise = at->sendCommand(cmd);
+  if (promise) {
+    promise->timeout(READ_REPLY_TIMEOUT_MS);
+    pendingReads.push_back({connectId, promise->getId(), false});
+  }
+  xSemaphoreGive(readMutex);
+  if (!promise) {
+    log_e("Failed to send %s", cmd);
+    failed |= 1u << connectId;
+  }
+  failReads(failed);
+}
+
+uint16_t AsyncEG915U::reapPendingReadsLocked() {
+  uint16_t failed = 0;
+  while (!pendingReads.empty()) {
+    const PendingRead &front = pendingReads.front();
+    if (!at->popCompletedPromise(front.promiseId)) break;
+    if (!front.replied && front.connectId >= 0) {
+      log_w("Read on connectID %d got no data reply", front.connectId);
+      failed |= 1u << front.connectId;
+    }
+    pendingReads.pop_front();
+  }
+  return failed;
+}
+
+void AsyncEG915U::failReads(uint16_t mask) {
+  // The transports wait for a chunk that will never come; their next read goes out from the
+  // application's available()/read(), not from here
+  for (int i = 0; i < EG915_MAX_SOCKETS; i++) {
+    if (!(mask & (1u << i))) continue;
+    if (GSMTransport *transport = transportFor(i)) { transport->finishChunk(0); }
+  }
+}
+
+int AsyncEG915U::popPendingRead() {
+  xSemaphoreTake(readMutex, portMAX_DELAY);
+  // Requests ahead of this reply have finished: they were answered or failed
+  uint16_t failed = reapPendingReadsLocked();
+  int connectId = -1;
+  for (PendingRead &read : pendingReads) {
+    if (read.replied) continue;
+    read.replied = true;
+    connectId = read.connectId;
+    break;
+  }
+  bool unexpected = pendingReads.empty() || connectId == -1;
+  xSemaphoreGive(readMutex);
+  if (unexpected) log_w("Read reply without a pending request, dropping it");
+  failReads(failed);
+  return connectId;
+}
+
+void AsyncEG915U::dropPendingReads(uint8_t connectId) {
+  xSemaphoreTake(readMutex, portMAX_DELAY);
+  for (PendingRead &read : pendingReads) {
+    if (read.connectId == connectId) read.connectId = -1;
+  }
+  xSemaphoreGive(readMutex);
+}
+
 bool AsyncEG915U::setEchoOff() { return at->sendSync("ATE0"); }
 
 bool AsyncEG915U::enableVerboseErrors() { return at->sendSync("AT+CMEE=2"); }
 
+bool AsyncEG915U::configureModem() {
+  if (!at->sendSync("ATE0;+CMEE=2;+CTZU=1;+QSCLK=0")) {
+    log_e("Failed to apply base modem configuration");
+    return false;
+  }
+  return true;
+}
+
+bool AsyncEG915U::enableNetworkURCs() {
+  if (!at->sendSync("AT+CREG=1;+CEREG=1;+CGEREP=2,1")) {
+    log_w("Failed to enable network URCs, falling back to polling");
+    return false;
+  }
+  return true;
+}
+
+void AsyncEG915U::drainEvents() {
+  if (urcSignal) { xSemaphoreTake(urcSignal, 0); }
+}
+
+bool AsyncEG915U::waitForEvent(uint32_t timeoutMs) {
+  if (!urcSignal) {
+    vTaskDelay(pdMS_TO_TICKS(timeoutMs));
+    return false;
+  }
+  return xSemaphoreTake(urcSignal, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
 bool AsyncEG915U::checkModemModel() {
-  String model;
-  if (!at->sendSync("AT+CGMM", model)) {
+  // Both identification queries in one round trip
+  String ident;
+  if (!at->sendSync("AT+CGMM;+CGMI", ident)) {
     log_e("Failed to get modem model");
     return false;
   }
-  if (model.indexOf("EG915U") == -1) {
+  if (ident.indexOf("EG915U") == -1) {
     log_e("Modem model is not EG915U");
     return false;
   }
-  String mfr;
-  if (!at->sendSync("AT+CGMI", mfr)) {
-    log_e("Failed to get modem manufacturer");
-    return false;
-  }
-  if (mfr.indexOf("Quectel") == -1) {
+  if (ident.indexOf("Quectel") == -1) {
     log_e("Modem manufacturer is not Quectel");
     return false;
   }
   return true;
 }
 
-bool AsyncEG915U::checkTimezone() { return at->sendSync("AT+CTZU=1"); }
-
 bool AsyncEG915U::checkSIMReady() {
   String r;
   if (!at->sendSync("AT+CPIN?", r)) return false;
-  return r.indexOf("READY") != -1;
+  bool ready = r.indexOf("+CPIN: READY") != -1;
+  URCState.simReady.store(ready);
+  return ready;
+}
+
+bool AsyncEG915U::waitForSIMReady(uint32_t timeoutMs) {
+  const TickType_t start = xTaskGetTickCount();
+  const TickType_t limit = pdMS_TO_TICKS(timeoutMs);
+  while (true) {
+    if (URCState.simReady.load() || checkSIMReady()) return true;
+    // A +CPIN that raced the poll has already updated simReady before signalling
+    drainEvents();
+    if (URCState.simReady.load()) return true;
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    if (elapsed >= limit) break;
+    // Wake on +CPIN; re-query now and then in case the URC went out before we listened
+    TickType_t slice = std::min<TickType_t>(limit - elapsed, pdMS_TO_TICKS(2000));
+    waitForEvent(slice * portTICK_PERIOD_MS);
+  }
+  log_e("SIM card not ready after %u ms", static_cast<unsigned>(timeoutMs));
+  return false;
+}
+
+// Bit per connectID listed by +QISTATE/+QSSLSTATE lines: "<header> <connectID>,..."
+static uint16_t parseOpenSockets(const String &resp, const char *header) {
+  uint16_t mask = 0;
+  int pos = 0;
+  int headerLen = strlen(header);
+  while ((pos = resp.indexOf(header, pos)) != -1) {
+    pos += headerLen;
+    int id = resp.substring(pos).toInt();
+    if (id >= 0 && id < EG915_MAX_SOCKETS) { mask |= (1u << id); }
+  }
+  return mask;
 }
 
 void AsyncEG915U::disableConnections() {
-  for (int i = 0; i < 4; i++) { at->sendSync(String("AT+QICLOSE=") + String(i)); }
+  // Only what is actually open; most bring-ups find nothing to close
+  String resp;
+  if (!at->sendSync("AT+QISTATE?;+QSSLSTATE?", resp)) {
+    log_w("Failed to query open sockets");
+    return;
+  }
+  closeSockets(parseOpenSockets(resp, "+QISTATE:"), parseOpenSockets(resp, "+QSSLSTATE:"));
+}
+
+void AsyncEG915U::closeSockets(uint16_t mask, uint16_t sslMask) {
+  for (int i = 0; i < EG915_MAX_SOCKETS; i++) {
+    if (mask & (1u << i)) { at->sendSync(String("AT+QICLOSE=") + String(i)); }
+    if (sslMask & (1u << i)) { at->sendSync(String("AT+QSSLCLOSE=") + String(i)); }
+    if ((mask | sslMask) & (1u << i)) { dropPendingReads(static_cast<uint8_t>(i)); }
+  }
+}
+
+bool AsyncEG915U::queryNetworkSnapshot(EG915NetworkSnapshot &out) {
+  String resp;
+  if (!at->sendSync("AT+CPIN?;+QDSIM?;+CREG?;+QICSGP=1;+QIACT?;+QISTATE?;+QSSLSTATE?", resp)) {
+    log_w("Combined state query failed");
+    return false;
+  }
+
+  out.simReady = resp.indexOf("+CPIN: READY") != -1;
+  URCState.simReady.store(out.simReady);
+  if (sim.updateSlotFrom(resp)) { out.simSlot = sim.cachedSlot(); }
+
+  int pos = resp.indexOf("+CREG:");
+  if (pos != -1) {
+    int lineEnd = resp.indexOf('\n', pos);
+    String line = lineEnd == -1 ? resp.substring(pos) : resp.substring(pos, lineEnd);
+    if (parseRegStatus(line, out.creg)) { URCState.creg.store(out.creg); }
+  }
+
+  // +QICSGP: <type>,"<apn>","<user>","<pass>",<auth>
+  pos = resp.indexOf("+QICSGP:");
+  if (pos != -1) {
+    int q1 = resp.indexOf('"', pos);
+    int q2 = q1 == -1 ? -1 : resp.indexOf('"', q1 + 1);
+    if (q2 != -1) { out.apn = resp.substring(q1 + 1, q2); }
+  }
+
+  out.pdpActive = resp.indexOf("+QIACT: 1,1") != -1;
+
+  // +QISTATE: <connectID>,"<service_type>",... one line per open socket, SSL ones separately
+  out.openSockets = parseOpenSockets(resp, "+QISTATE:");
+  out.openSslSockets = parseOpenSockets(resp, "+QSSLSTATE:");
+  return true;
 }
 
 bool AsyncEG915U::disalbeSleepMode() { return at->sendSync("AT+QSCLK=0"); }
@@ -195,37 +418,47 @@ String AsyncEG915U::getIPAddress() {
   return result;
 }
 
-bool AsyncEG915U::stop() {
+bool AsyncEG915U::stop(uint8_t connectId) {
+  if (connectId >= EG915_MAX_SOCKETS) return false;
+  std::atomic<ConnectionStatus> &state = URCState.socketState[connectId];
   // Request close
-  bool ok = at->sendSync("AT+QICLOSE=0");
+  bool ok = at->sendSync(String("AT+QICLOSE=") + String(connectId));
   // Wait briefly for URC to arrive and update state; under heavy logs this can be delayed
   if (ok) {
     TickType_t t0 = xTaskGetTickCount();
-    while (URCState.isConnected.load() != ConnectionStatus::DISCONNECTED &&
+    while (state.load() != ConnectionStatus::DISCONNECTED &&
            (xTaskGetTickCount() - t0) < pdMS_TO_TICKS(2000)) {
       vTaskDelay(pdMS_TO_TICKS(5));
     }
-    URCState.isConnected.store(ConnectionStatus::DISCONNECTED);
-    if (transport) { transport->reset(); }
+    state.store(ConnectionStatus::DISCONNECTED);
+    dropPendingReads(connectId);
+    if (GSMTransport *transport = transportFor(connectId)) { transport->reset(); }
   }
   return ok;
 }
 
-bool AsyncEG915U::connect(const char *host, uint16_t port) {
+bool AsyncEG915U::connect(const char *host, uint16_t port, uint8_t connectId) {
+  if (connectId >= EG915_MAX_SOCKETS) {
+    log_e("Invalid connectID %u", connectId);
+    return false;
+  }
+  std::atomic<ConnectionStatus> &state = URCState.socketState[connectId];
   String portStr(port);
-  URCState.isConnected.store(ConnectionStatus::DISCONNECTED);
-  at->sendSync(String("AT+QIOPEN=1,0,\"TCP\",\"") + host + "\"," + portStr + ",0,0");
+  state.store(ConnectionStatus::DISCONNECTED);
+  at->sendSync(
+      String("AT+QIOPEN=1,") + String(connectId) + ",\"TCP\",\"" + host + "\"," + portStr +
+      ",0,0");
 
   for (int i = 0; i < 20; i++) {
-    ConnectionStatus status = URCState.isConnected.load();
+    ConnectionStatus status = state.load();
     if (status == ConnectionStatus::CONNECTED || status == ConnectionStatus::FAILED) { break; }
     vTaskDelay(pdMS_TO_TICKS(500));
   }
 
-  if (URCState.isConnected.load() == ConnectionStatus::CONNECTED) {
+  if (state.load() == ConnectionStatus::CONNECTED) {
     log_d("Connection URC received successfully");
   } else {
     log_e("No +QIOPEN URC received or it indicated failure");
   }
-  return URCState.isConnected.load() == ConnectionStatus::CONNECTED;
+  return state.load() == ConnectionStatus::CONNECTED;
 }
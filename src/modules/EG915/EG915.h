@@ -3,19 +3,76 @@
 #include <Arduino.h>
 #include <AsyncATHandler.h>
 #include <Stream.h>
+#include <utils/GSMTransport/GSMTransport.h>
+#include <utils/MqttPublishWindow/MqttPublishWindow.h>
 #include <utils/MqttQueue/MqttQueue.h>
+#include <utils/UFSReader/UFSReader.h>
 
+#include <deque>
+#include <functional>
+
+#include "CertStore/CertStore.h"
 #include "EG915.settings.h"
 #include "SIMCard/SIMCard.h"
 
-class GSMTransport;
+// Modem state gathered by one combined query; lets a warm start skip what is already set up
+struct EG915NetworkSnapshot {
+  bool simReady{false};
+  EG915SimSlot simSlot{EG915SimSlot::UNKNOWN};
+  RegStatus creg{RegStatus::REG_NO_RESULT};
+  String apn;
+  bool pdpActive{false};
+  uint16_t openSockets{0};     // Bit per connectID listed by +QISTATE
+  uint16_t openSslSockets{0};  // Bit per clientID listed by +QSSLSTATE
+};
+
+// Fills buf with up to len bytes of the next part of a file being uploaded and returns how many;
+// 0 means the source has nothing more
+using UFSUploadReader = std::function<size_t(uint8_t *buf, size_t len)>;
+// Called after every block with the bytes handed to the modem so far
+using UFSUploadProgress = std::function<void(size_t sent, size_t total)>;
 
-class AsyncEG915U {
+class AsyncEG915U : public GSMReadRequester, public UFSFileRequester {
  private:
   Stream *_stream = nullptr;
-  GSMTransport *transport = nullptr;
+  GSMTransport *transports[EG915_MAX_SOCKETS] = {};
   AsyncATHandler *at;
-  bool certConfigured = false;
+
+  // What each SSL context and MQTT client was last configured with, so settings are only sent
+  // when they change. Empty/-1 means unknown. Cleared on RDY: a restarted modem is back to its
+  // defaults.
+  static constexpr size_t SSL_SETTING_COUNT = 8;
+  String sslApplied[EG915_SSL_CONTEXTS][SSL_SETTING_COUNT];
+  int8_t mqttSslApplied[EG915_MQTT_CLIENTS];
+  // Certificate paths requested per SSL context; kept across RDY so they can be applied again
+  String certPaths[EG915_SSL_CONTEXTS][EG915_CERT_KINDS];
+  EG915SslOptions sslOptions;
+
+  // connectIDs of the +QIRD/+QSSLRECV replies still expected, in the order they were requested
+  struct PendingRead {
+    int connectId;  // -1 once the socket closed: its reply is still read, then dropped
+    uint32_t promiseId;
+    bool replied;
+  };
+  std::deque<PendingRead> pendingReads;
+  // Covers the reply header plus the payload read of onReadData()
+  static constexpr uint32_t READ_REPLY_TIMEOUT_MS = 6000;
+  SemaphoreHandle_t readMutex = xSemaphoreCreateMutex();
+  // connectID the next read reply belongs to, or -1 when it belongs to nobody
+  int popPendingRead();
+  // Drops finished requests from the front of the FIFO. Returns a bit per connectID whose read
+  // ended in ERROR or timed out without a reply.
+  uint16_t reapPendingReadsLocked();
+  void failReads(uint16_t mask);
+  // Keeps the FIFO aligned while forgetting the socket's outstanding reads
+  void dropPendingReads(uint8_t connectId);
+  GSMTransport *transportFor(int connectId);
+
+  // Given by every bring-up relevant URC (+CPIN, +CREG/+CEREG, +CGEV) so waiters wake early
+  SemaphoreHandle_t urcSignal = xSemaphoreCreateBinary();
+  // Drops a pending signal; our own polls can raise it when their replies are routed as URCs
+  void drainEvents();
+  static bool parseRegStatus(const String &line, RegStatus &out);
 
   // Dynamic URC registration helpers
   void registerURCs();
@@ -29,21 +86,72 @@ class AsyncEG915U {
   void onTcpRecv(const String &urc);
   void onSslRecv(const String &urc);
   void onReadData(const String &urc);
+  void onSimState(const String &urc);
+  void onPdpEvent(const String &urc);
   void onMqttRecv(const String &urc);
+  MqttMessage mqttRxScratch;
+  // Messages the modem buffered, as announced by header-only +QMTRECV notices, oldest first.
+  // The notice is only recorded: AT+QMTRECV goes out later through the AT handler.
+  struct MqttFetch {
+    uint8_t client;
+    uint8_t recvId;
+  };
+  std::deque<MqttFetch> mqttFetches;
+  SemaphoreHandle_t mqttFetchMutex = xSemaphoreCreateMutex();
+  static constexpr uint32_t MQTT_RECV_TIMEOUT_MS = 5000;
+  // Held while mqttQueueSub is used, so setMqttQueue() cannot pull it from under a push
+  SemaphoreHandle_t mqttQueueMutex = xSemaphoreCreateMutex();
+  void queueMqttMessage(MqttMessage &msg);
   void onMqttStat(const String &urc);
+  void onMqttPubAck(const String &urc);
+  void onMqttSubAck(const String &urc);
+  void onModemReady(const String &urc);
+
+  // Destination of the AT+QFREAD in flight; the CONNECT reply's bytes are read straight into it
+  struct FileRead {
+    uint8_t *buf{nullptr};
+    size_t len{0};
+    int received{-1};
+  } fileRead;
+  // fileReadMutex serializes readers; fileBufMutex guards fileRead, which onFileData() writes
+  // through while readFile() waits for it
+  SemaphoreHandle_t fileReadMutex = xSemaphoreCreateMutex();
+  SemaphoreHandle_t fileBufMutex = xSemaphoreCreateMutex();
+  // The CONNECT URC is only registered while files are open, so it cannot catch AT+QFUPL's prompt
+  uint8_t openFiles{0};
+  void onFileData(const String &urc);
+  // The +QFUPL: <size>,<checksum> line of the upload in progress
+  String uploadReport;
+
+  // 2 with a client certificate and key, 1 with a CA, else 0
+  const char *secLevelFor(uint8_t sslCtx) const;
 
  public:
   UrcState URCState;
   AtomicMqttQueue *mqttQueueSub = nullptr;
+  // Where +QMTRECV messages go from now on, once a push in progress is done; nullptr drops them
+  void setMqttQueue(AtomicMqttQueue *queue);
+  MqttPublishWindow *mqttPublishWindow = nullptr;
   EG915SIMCard sim;
+  EG915CertStore certs;
 
   AsyncEG915U();
   ~AsyncEG915U();
-  bool init(Stream &stream, AsyncATHandler &atHandler, GSMTransport &transport);
+  bool init(Stream &stream, AsyncATHandler &atHandler);
+  // Routes URCs and read replies for connectId to transport; nullptr detaches it
+  void attachTransport(uint8_t connectId, GSMTransport *transport);
+  void requestRead(uint8_t connectId, bool ssl, size_t len) override;
   bool setEchoOff();
   bool enableVerboseErrors();
+  // Echo off, verbose errors, timezone sync and no sleep in one round trip
+  bool configureModem();
+  // Turns on the +CREG/+CEREG/+CGEV reports the bring-up waits on
+  bool enableNetworkURCs();
+  bool waitForSIMReady(uint32_t timeoutMs);
+  bool waitForRegistration(uint32_t timeoutMs);
+  // Blocks until a bring-up URC arrives or timeoutMs elapses; true if one arrived
+  bool waitForEvent(uint32_t timeoutMs);
   bool checkModemModel();
-  bool checkTimezone();
   bool checkSIMReady();
   bool disalbeSleepMode();
   bool gprsConnect(const char *apn, const char *user = nullptr, const char *pass = nullptr);
@@ -53,20 +161,53 @@ class AsyncEG915U {
   String getIMSI();
   String getOperator();
   String getIPAddress();
-  bool connect(const char *host, uint16_t port);
-  bool stop();
-  bool connectSecure(const char *host, uint16_t port);
-  bool connectSecure(const char *host, uint16_t port, const char *caCertPath);
-  bool stopSecure();
+  bool connect(const char *host, uint16_t port, uint8_t connectId = 0);
+  bool stop(uint8_t connectId = 0);
+  // Applies to the next connectSecure(); only settings that differ are sent
+  void setSslOptions(const EG915SslOptions &options) { sslOptions = options; }
+  const EG915SslOptions &getSslOptions() const { return sslOptions; }
+  bool connectSecure(const char *host, uint16_t port, uint8_t connectId = 0);
+  bool stopSecure(uint8_t connectId = 0);
   bool setSIMSlot(EG915SimSlot slot);
 
   bool uploadUFSFile(
       const char *path, const uint8_t *data, size_t size, uint32_t timeoutMs = 120000);
+  // Streams size bytes from reader in EG915_UFS_UPLOAD_BLOCK blocks, so memory use does not
+  // depend on the file size, and checks the size and checksum the modem reports back
+  bool uploadUFSFile(
+      const char *path, size_t size, const UFSUploadReader &reader,
+      const UFSUploadProgress &progress = nullptr, uint32_t timeoutMs = 120000);
+  bool uploadUFSFile(
+      const char *path, Stream &source, size_t size, const UFSUploadProgress &progress = nullptr,
+      uint32_t timeoutMs = 120000);
   bool setCACertificate(const char *ufsPath, const char *ssl_cidx);
+  // Points kind of sslCtx at a UFS file, or forgets it when ufsPath is empty
+  bool setCertificate(uint8_t sslCtx, EG915CertKind kind, const char *ufsPath);
+  const String &certificatePath(uint8_t sslCtx, EG915CertKind kind) const;
+  // Points sslCtx at the certificates given to setCertificate() again if the modem lost them;
+  // true when there is nothing to do
+  bool applyCertificates(uint8_t sslCtx);
+  // AT+QSSLCFG="<name>",<sslCtx>,<value>, skipped when the context already has that value
+  bool configureSsl(uint8_t sslCtx, const char *name, const String &value);
+  // AT+QMTCFG="ssl" for an MQTT client, skipped when unchanged
+  bool configureMqttSsl(uint8_t client, bool enable, uint8_t sslCtx);
+  // Sends AT+QMTRECV for the oldest message a +QMTRECV notice announced for client; the reply is
+  // queued like a pushed message. False once none is waiting. Not for the URC reader task.
+  bool fetchMqttMessage(uint8_t client);
+  void invalidateConfigCache();
   bool findUFSFile(const char *pattern, String *outName = nullptr, size_t *outSize = nullptr);
+  // Read-only file access for UFSReader
+  int openFile(const char *name, size_t &size) override;
+  int readFile(int handle, uint8_t *buf, size_t len) override;
+  bool seekFile(int handle, size_t offset) override;
+  bool closeFile(int handle) override;
+
+  bool queryNetworkSnapshot(EG915NetworkSnapshot &out);
 
   // Helpers for GPRS connection
   void disableConnections();
+  // AT+QICLOSE for each bit of mask and AT+QSSLCLOSE for each bit of sslMask
+  void closeSockets(uint16_t mask, uint16_t sslMask = 0);
   bool setPDPContext(const char *apn);
   bool activatePDPContext();
   bool isGPRSSAttached();
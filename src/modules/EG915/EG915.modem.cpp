@@ -1,27 +1,47 @@
 #include "EG915.h"
 
+#include <algorithm>
+
 #include "esp_log.h"
 
-bool AsyncEG915U::setPDPContext(const char *apn) {
-  ATPromise *promise = at->sendCommand("AT+CREG?");
-  int attempts = 0;
-  while (URCState.creg.load() != RegStatus::REG_OK_HOME &&
-         URCState.creg.load() != RegStatus::REG_OK_ROAMING) {
-    log_v("Waiting for network registration...");
-    vTaskDelay(pdMS_TO_TICKS(2000));
-    promise = at->sendCommand("AT+CREG?");
-    if (!promise->wait() || !promise->getResponse()->isSuccess()) {
+static bool isRegistered(RegStatus status) {
+  return status == RegStatus::REG_OK_HOME || status == RegStatus::REG_OK_ROAMING;
+}
+
+bool AsyncEG915U::waitForRegistration(uint32_t timeoutMs) {
+  const TickType_t start = xTaskGetTickCount();
+  const TickType_t limit = pdMS_TO_TICKS(timeoutMs);
+  while (!isRegistered(URCState.creg.load())) {
+    String resp;
+    if (!at->sendSync("AT+CREG?", resp)) {
       log_e("Failed to get network registration status");
-      at->popCompletedPromise(promise->getId());
       return false;
     }
-    at->popCompletedPromise(promise->getId());
-    attempts++;
-    if (attempts >= 10) {
+    // The solicited reply goes through the same parser as the URC
+    int pos = resp.indexOf("+CREG:");
+    RegStatus status;
+    if (pos != -1) {
+      int lineEnd = resp.indexOf('\n', pos);
+      String line = lineEnd == -1 ? resp.substring(pos) : resp.substring(pos, lineEnd);
+      if (parseRegStatus(line, status)) { URCState.creg.store(status); }
+    }
+    drainEvents();
+    if (isRegistered(URCState.creg.load())) break;
+
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    if (elapsed >= limit) {
       log_e("Network registration timed out");
       return false;
     }
+    log_v("Waiting for network registration...");
+    TickType_t slice = std::min<TickType_t>(limit - elapsed, pdMS_TO_TICKS(2000));
+    waitForEvent(slice * portTICK_PERIOD_MS);
   }
+  return true;
+}
+
+bool AsyncEG915U::setPDPContext(const char *apn) {
+  if (!waitForRegistration(EG915_REGISTRATION_TIMEOUT_MS)) return false;
   // Set the PDP context
   return at->sendSync(String("AT+CGDCONT=1,\"IP\",\"") + apn + "\"");
 }
@@ -3,67 +3,207 @@
 #include <MD5Builder.h>
 #include <utils/GSMTransport/GSMTransport.h>
 
+#include <algorithm>
+
 #include "esp_log.h"
 
-bool AsyncEG915U::connectSecure(const char *host, uint16_t port) {
-  // Enable TLS 1.2
-  if (!at->sendSync("AT+QSSLCFG=\"sslversion\",1,3")) {
+// Settings tracked per SSL context, in the order of sslApplied's columns
+static const char *const SSL_SETTING_NAMES[] = {
+    "sslversion", "ciphersuite", "sni", "session", "seclevel", "cacert", "clientcert",
+    "clientkey"};
+
+// AT+QSSLCFG setting of each EG915CertKind
+static const char *const CERT_SETTING_NAMES[EG915_CERT_KINDS] = {
+    "cacert", "clientcert", "clientkey"};
+
+static int sslSettingIndex(const char *name) {
+  for (size_t i = 0; i < sizeof(SSL_SETTING_NAMES) / sizeof(SSL_SETTING_NAMES[0]); i++) {
+    if (strcmp(SSL_SETTING_NAMES[i], name) == 0) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+void AsyncEG915U::invalidateConfigCache() {
+  for (auto &context : sslApplied) {
+    for (auto &value : context) value = String();
+  }
+  for (auto &client : mqttSslApplied) client = -1;
+}
+
+bool AsyncEG915U::configureSsl(uint8_t sslCtx, const char *name, const String &value) {
+  if (sslCtx >= EG915_SSL_CONTEXTS) {
+    log_e("Invalid SSL context %u", sslCtx);
+    return false;
+  }
+  int setting = sslSettingIndex(name);
+  if (setting >= 0 && sslApplied[sslCtx][setting] == value) return true;
+
+  if (!at->sendSync(String("AT+QSSLCFG=\"") + name + "\"," + String(sslCtx) + "," + value)) {
+    if (setting >= 0) sslApplied[sslCtx][setting] = String();
+    return false;
+  }
+  if (setting >= 0) sslApplied[sslCtx][setting] = value;
+  return true;
+}
+
+bool AsyncEG915U::configureMqttSsl(uint8_t client, bool enable, uint8_t sslCtx) {
+  if (client >= EG915_MQTT_CLIENTS || sslCtx >= EG915_SSL_CONTEXTS) {
+    log_e("Invalid MQTT client %u or SSL context %u", client, sslCtx);
+    return false;
+  }
+  int8_t wanted = static_cast<int8_t>((enable ? 0x10 : 0) | sslCtx);
+  if (mqttSslApplied[client] == wanted) return true;
+
+  if (!at->sendSync(
+          String("AT+QMTCFG=\"ssl\",") + String(client) + "," + (enable ? "1" : "0") + "," +
+          String(sslCtx))) {
+    mqttSslApplied[client] = -1;
+    return false;
+  }
+  mqttSslApplied[client] = wanted;
+  return true;
+}
+
+bool AsyncEG915U::connectSecure(const char *host, uint16_t port, uint8_t connectId) {
+  if (connectId >= EG915_MAX_SOCKETS) {
+    log_e("Invalid connectID %u", connectId);
+    return false;
+  }
+  std::atomic<ConnectionStatus> &state = URCState.socketState[connectId];
+
+  // Only settings SSL context 1 does not already have go out, so repeat connects cost no
+  // configuration round trips
+  if (!configureSsl(1, "sslversion", String(static_cast<uint8_t>(sslOptions.version)))) {
     log_e("Failed to set SSL version");
     return false;
   }
 
-  // Allow a strong default cipher suite (RSA with AES-256-CBC-SHA)
-  if (!at->sendSync("AT+QSSLCFG=\"ciphersuite\",1,0X0035")) {
+  char suite[8];
+  snprintf(suite, sizeof(suite), "0X%04X", static_cast<unsigned>(sslOptions.cipherSuite));
+  if (!configureSsl(1, "ciphersuite", suite)) {
     log_e("Failed to set SSL cipher suite");
     return false;
   }
 
-  // Enable SNI so the server can select proper certificate when using hostnames
-  at->sendSync("AT+QSSLCFG=\"sni\",1,1");
+  // SNI lets the server select the proper certificate when using hostnames
+  configureSsl(1, "sni", sslOptions.sni ? "1" : "0");
+
+  // With resumption on, the modem keeps the session of its last connection on this context and
+  // offers it again when reconnecting to the same server
+  if (!configureSsl(1, "session", sslOptions.sessionResumption ? "1" : "0")) {
+    log_e("Failed to set SSL session resumption");
+    return false;
+  }
+
+  // A modem restart since setCertificate() dropped the certificate paths
+  if (!applyCertificates(1)) {
+    log_e("Failed to restore SSL certificates");
+    return false;
+  }
 
-  // Set security level: 1 when CA is configured, else 0 (insecure)
-  if (!at->sendSync(String("AT+QSSLCFG=\"seclevel\",1,") + (certConfigured ? "1" : "0"))) {
+  // Set security level: 2 with a client certificate, 1 when CA is configured, else 0 (insecure)
+  if (!configureSsl(1, "seclevel", secLevelFor(1))) {
     log_e("Failed to set SSL security level");
     return false;
   }
 
-  // Open SSL connection (PDP ctx=1, SSL ctx=1, clientid=0)
-  URCState.isConnected.store(ConnectionStatus::DISCONNECTED);
-  at->sendSync(String("AT+QSSLOPEN=1,1,0,\"") + host + "\"," + String(port) + ",0");
+  // Open SSL connection (PDP ctx=1, SSL ctx=1, clientid=connectId)
+  state.store(ConnectionStatus::DISCONNECTED);
+  at->sendSync(
+      String("AT+QSSLOPEN=1,1,") + String(connectId) + ",\"" + host + "\"," + String(port) +
+      ",0");
 
   for (int i = 0; i < 20; i++) {
-    ConnectionStatus status = URCState.isConnected.load();
+    ConnectionStatus status = state.load();
     if (status == ConnectionStatus::CONNECTED || status == ConnectionStatus::FAILED) { break; }
     vTaskDelay(pdMS_TO_TICKS(500));
   }
 
-  if (URCState.isConnected.load() == ConnectionStatus::CONNECTED) {
+  if (state.load() == ConnectionStatus::CONNECTED) {
     log_d("Connection URC received successfully");
   } else {
     log_e("No +QIOPEN URC received or it indicated failure");
   }
-  return URCState.isConnected.load() == ConnectionStatus::CONNECTED;
+  return state.load() == ConnectionStatus::CONNECTED;
 }
 
-bool AsyncEG915U::stopSecure() {
+bool AsyncEG915U::stopSecure(uint8_t connectId) {
+  if (connectId >= EG915_MAX_SOCKETS) return false;
+  std::atomic<ConnectionStatus> &state = URCState.socketState[connectId];
   // Request close
-  bool ok = at->sendSync("AT+QSSLCLOSE=0");
+  bool ok = at->sendSync(String("AT+QSSLCLOSE=") + String(connectId));
   // Wait briefly for URC to arrive and update state; under heavy logs this can be delayed
   if (ok) {
     TickType_t t0 = xTaskGetTickCount();
-    while (URCState.isConnected.load() != ConnectionStatus::DISCONNECTED &&
+    while (state.load() != ConnectionStatus::DISCONNECTED &&
            (xTaskGetTickCount() - t0) < pdMS_TO_TICKS(2000)) {
       vTaskDelay(pdMS_TO_TICKS(5));
     }
-    URCState.isConnected.store(ConnectionStatus::DISCONNECTED);
-    if (transport) { transport->reset(); }
+    state.store(ConnectionStatus::DISCONNECTED);
+    dropPendingReads(connectId);
+    if (GSMTransport *transport = transportFor(connectId)) { transport->reset(); }
   }
   return ok;
 }
 
+// Written by AT+QFUPL once the upload is in
+static const char *const UPLOAD_REPORT_URC = "+QFUPL:";
+
+// Reads <size>,<checksum> from "+QFUPL: <size>,<checksum>", the checksum in hex
+static bool parseUploadReport(const String &line, size_t &size, uint16_t &checksum) {
+  int colon = line.indexOf(':');
+  int comma = colon == -1 ? -1 : line.indexOf(',', colon + 1);
+  if (comma == -1) return false;
+  String sizeText = line.substring(colon + 1, comma);
+  String sumText = line.substring(comma + 1);
+  sizeText.trim();
+  sumText.trim();
+  if (sizeText.length() == 0 || sumText.length() == 0) return false;
+  char *end = nullptr;
+  unsigned long value = strtoul(sizeText.c_str(), &end, 10);
+  if (*end != '\0') return false;
+  size = static_cast<size_t>(value);
+  value = strtoul(sumText.c_str(), &end, 16);
+  if (*end != '\0' || value > 0xFFFF) return false;
+  checksum = static_cast<uint16_t>(value);
+  return true;
+}
+
+// +QFUPL checksum: XOR of the data as big-endian 16-bit words, an odd last byte padded with 0
+static uint16_t ufsChecksum(uint16_t sum, size_t offset, const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    sum ^= ((offset + i) & 1) ? data[i] : static_cast<uint16_t>(data[i] << 8);
+  }
+  return sum;
+}
+
 bool AsyncEG915U::uploadUFSFile(
     const char *path, const uint8_t *data, size_t size, uint32_t timeoutMs) {
-  if (!path || !*path || !data || size == 0) {
+  if (!data) {
+    log_e("Invalid params for uploadUFSFile");
+    return false;
+  }
+  size_t offset = 0;
+  auto reader = [data, size, &offset](uint8_t *buf, size_t len) {
+    size_t n = std::min(len, size - offset);
+    memcpy(buf, data + offset, n);
+    offset += n;
+    return n;
+  };
+  return uploadUFSFile(path, size, reader, nullptr, timeoutMs);
+}
+
+bool AsyncEG915U::uploadUFSFile(
+    const char *path, Stream &source, size_t size, const UFSUploadProgress &progress,
+    uint32_t timeoutMs) {
+  auto reader = [&source](uint8_t *buf, size_t len) { return source.readBytes(buf, len); };
+  return uploadUFSFile(path, size, reader, progress, timeoutMs);
+}
+
+bool AsyncEG915U::uploadUFSFile(
+    const char *path, size_t size, const UFSUploadReader &reader,
+    const UFSUploadProgress &progress, uint32_t timeoutMs) {
+  if (!path || !*path || !reader || size == 0) {
     log_e("Invalid params for uploadUFSFile");
     return false;
   }
@@ -86,18 +226,68 @@ bool AsyncEG915U::uploadUFSFile(
     return false;
   }
 
-  // Send file bytes
-  at->getStream()->write(data, size);
-  at->getStream()->flush();
+  // The report comes before the final OK, so it is in by the time the promise completes
+  uploadReport = "";
+  at->urc.registerEvent(UPLOAD_REPORT_URC, [this](const String &u) { uploadReport = u; });
+  registeredURCPatterns.push_back(UPLOAD_REPORT_URC);
+
+  // One block at a time; flush() holds us back until the UART took the previous one
+  Stream *stream = at->getStream();
+  uint8_t block[EG915_UFS_UPLOAD_BLOCK];
+  uint16_t checksum = 0;
+  size_t sent = 0;
+  bool complete = true;
+  while (sent < size) {
+    size_t want = std::min(size - sent, sizeof(block));
+    size_t got = complete ? reader(block, want) : 0;
+    if (got == 0 || got > want) {
+      // The modem only ends the upload after size bytes; pad it out and drop the file below
+      if (complete) {
+        log_e(
+            "Upload source ended after %u of %u bytes", static_cast<unsigned>(sent),
+            static_cast<unsigned>(size));
+      }
+      complete = false;
+      memset(block, 0, want);
+      got = want;
+    }
+    checksum = ufsChecksum(checksum, sent, block, got);
+    stream->write(block, got);
+    stream->flush();
+    sent += got;
+    if (complete && progress) progress(sent, size);
+  }
 
   // Wait for command completion (OK)
   bool ok = promise->wait();
   auto p = at->popCompletedPromise(promise->getId());
+  at->urc.unregisterEvent(UPLOAD_REPORT_URC);
+  auto it = std::find(
+      registeredURCPatterns.begin(), registeredURCPatterns.end(), String(UPLOAD_REPORT_URC));
+  if (it != registeredURCPatterns.end()) registeredURCPatterns.erase(it);
   if (!ok || !p || !p->getResponse()->isSuccess()) {
     log_e("QFUPL failed or not acknowledged");
     return false;
   }
 
+  // +QFUPL: <size>,<checksum> describes what actually landed in UFS
+  size_t reportedSize = 0;
+  uint16_t reportedChecksum = 0;
+  if (complete && uploadReport.length() > 0) {
+    if (!parseUploadReport(uploadReport, reportedSize, reportedChecksum) ||
+        reportedSize != size || reportedChecksum != checksum) {
+      log_e(
+          "Upload of %s corrupted: modem reported '%s', expected %u,%x", path,
+          uploadReport.c_str(), static_cast<unsigned>(size), static_cast<unsigned>(checksum));
+      complete = false;
+    }
+  } else if (complete) {
+    log_w("No +QFUPL report, upload of %s not verified", path);
+  }
+  if (!complete) {
+    at->sendSync(String("AT+QFDEL=\"") + path + "\"");
+    return false;
+  }
   return true;
 }
 
@@ -106,17 +296,63 @@ bool AsyncEG915U::setCACertificate(const char *ufsPath, const char *ssl_cidx) {
     log_e("Invalid CA cert path");
     return false;
   }
-  String cmd = String("AT+QSSLCFG=\"cacert\",") + ssl_cidx + ",\"" + ufsPath + "\"";
-  if (!at->sendSync(cmd)) {
-    log_e("Failed to set CA certificate path");
+  long sslCtx = String(ssl_cidx).toInt();
+  if (sslCtx < 0 || sslCtx >= EG915_SSL_CONTEXTS) {
+    log_e("Invalid SSL context %s", ssl_cidx);
     return false;
   }
-  cmd = String("AT+QSSLCFG=\"seclevel\",") + ssl_cidx + ",1";
-  if (!at->sendSync(cmd)) {
-    log_e("Failed to set SSL seclevel to 1");
+  return setCertificate(static_cast<uint8_t>(sslCtx), EG915CertKind::CA_CERT, ufsPath);
+}
+
+bool AsyncEG915U::setCertificate(uint8_t sslCtx, EG915CertKind kind, const char *ufsPath) {
+  size_t k = static_cast<size_t>(kind);
+  if (sslCtx >= EG915_SSL_CONTEXTS || k >= EG915_CERT_KINDS) {
+    log_e("Invalid SSL context %u", sslCtx);
+    return false;
+  }
+  certPaths[sslCtx][k] = ufsPath ? ufsPath : "";
+  return applyCertificates(sslCtx);
+}
+
+const String &AsyncEG915U::certificatePath(uint8_t sslCtx, EG915CertKind kind) const {
+  static const String none;
+  size_t k = static_cast<size_t>(kind);
+  if (sslCtx >= EG915_SSL_CONTEXTS || k >= EG915_CERT_KINDS) return none;
+  return certPaths[sslCtx][k];
+}
+
+const char *AsyncEG915U::secLevelFor(uint8_t sslCtx) const {
+  const String *paths = certPaths[sslCtx];
+  size_t cert = static_cast<size_t>(EG915CertKind::CLIENT_CERT);
+  size_t key = static_cast<size_t>(EG915CertKind::CLIENT_KEY);
+  if (paths[cert].length() > 0 && paths[key].length() > 0) return "2";
+  if (paths[static_cast<size_t>(EG915CertKind::CA_CERT)].length() > 0) return "1";
+  return "0";
+}
+
+bool AsyncEG915U::applyCertificates(uint8_t sslCtx) {
+  if (sslCtx >= EG915_SSL_CONTEXTS) return true;
+  bool any = false;
+  for (size_t k = 0; k < EG915_CERT_KINDS; k++) {
+    const String &path = certPaths[sslCtx][k];
+    if (path.length() == 0) {
+      // The modem keeps a released path; forget it so setting it again is not skipped
+      sslApplied[sslCtx][sslSettingIndex(CERT_SETTING_NAMES[k])] = String();
+      continue;
+    }
+    if (!configureSsl(sslCtx, CERT_SETTING_NAMES[k], "\"" + path + "\"")) {
+      log_e("Failed to set SSL %s path", CERT_SETTING_NAMES[k]);
+      return false;
+    }
+    any = true;
+  }
+  // Without certificates only a level left over from released ones needs taking back
+  const String &level = sslApplied[sslCtx][sslSettingIndex("seclevel")];
+  if (!any && (level.length() == 0 || level == "0")) return true;
+  if (!configureSsl(sslCtx, "seclevel", secLevelFor(sslCtx))) {
+    log_e("Failed to set SSL seclevel");
     return false;
   }
-  certConfigured = true;
   return true;
 }
 
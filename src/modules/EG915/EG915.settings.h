@@ -1,7 +1,19 @@
 #pragma once
 
+#include <stdint.h>
+
 #include <atomic>
 
+// connectID range shared by AT+QIOPEN and AT+QSSLOPEN
+static constexpr uint8_t EG915_MAX_SOCKETS = 12;
+// SSL context IDs of AT+QSSLCFG and client indexes of AT+QMTCFG both range 0-5
+static constexpr uint8_t EG915_SSL_CONTEXTS = 6;
+static constexpr uint8_t EG915_MQTT_CLIENTS = 6;
+// Bytes pulled from the source and written to the UART per step of a streaming AT+QFUPL
+static constexpr size_t EG915_UFS_UPLOAD_BLOCK = 512;
+// How long bring-up and AT+CGDCONT wait for +CREG/+CEREG to report a network
+static constexpr uint32_t EG915_REGISTRATION_TIMEOUT_MS = 20000;
+
 enum class RegStatus {
   REG_NO_RESULT = -1,
   REG_UNREGISTERED = 0,
@@ -27,6 +39,45 @@ enum class MqttConnectionState {
 
 struct UrcState {
   std::atomic<RegStatus> creg{RegStatus::REG_NO_RESULT};
-  std::atomic<ConnectionStatus> isConnected{ConnectionStatus::DISCONNECTED};
+  std::atomic<bool> simReady{false};
+  // Indexed by connectID; zero-initialised to DISCONNECTED
+  std::atomic<ConnectionStatus> socketState[EG915_MAX_SOCKETS]{};
   std::atomic<MqttConnectionState> mqttState{MqttConnectionState::IDLE};
 };
+
+// AT+QSSLCFG="sslversion" values
+enum class EG915TlsVersion : uint8_t {
+  SSL_3_0 = 0,
+  TLS_1_0 = 1,
+  TLS_1_1 = 2,
+  TLS_1_2 = 3,
+  ALL = 4,
+};
+
+// AT+QSSLCFG="ciphersuite" values. The modem takes a single suite, or EG915_CIPHERS_ALL to offer
+// every suite it supports and let the server choose.
+static constexpr uint16_t EG915_CIPHER_RSA_AES_256_CBC_SHA = 0x0035;
+static constexpr uint16_t EG915_CIPHER_ECDHE_RSA_AES_128_GCM_SHA256 = 0xC02F;
+static constexpr uint16_t EG915_CIPHER_ECDHE_RSA_AES_256_GCM_SHA384 = 0xC030;
+static constexpr uint16_t EG915_CIPHER_ECDHE_ECDSA_AES_128_GCM_SHA256 = 0xC02B;
+static constexpr uint16_t EG915_CIPHERS_ALL = 0xFFFF;
+
+// How connectSecure() sets up its SSL context
+struct EG915SslOptions {
+  EG915TlsVersion version{EG915TlsVersion::TLS_1_2};
+  uint16_t cipherSuite{EG915_CIPHER_RSA_AES_256_CBC_SHA};
+  bool sni{true};
+  // AT+QSSLCFG="session": reconnects to the same server resume the TLS session instead of
+  // running a full handshake
+  bool sessionResumption{false};
+
+  // TLS 1.2 with RSA AES-256-CBC only and a full handshake on every connect
+  static EG915SslOptions compatible() { return EG915SslOptions(); }
+  // TLS 1.2 offering every suite, so servers can pick ECDHE/GCM, and resuming sessions
+  static EG915SslOptions fast() {
+    EG915SslOptions options;
+    options.cipherSuite = EG915_CIPHERS_ALL;
+    options.sessionResumption = true;
+    return options;
+  }
+};
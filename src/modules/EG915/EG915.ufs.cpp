@@ -0,0 +1,82 @@
+#include "EG915.h"
+
+#include <algorithm>
+
+#include "esp_log.h"
+
+// AT+QFREAD's reply header; registered while any file is open
+static const char *const FILE_DATA_URC = "CONNECT ";
+// Covers the modem's answer plus the payload timeout of onFileData()
+static constexpr uint32_t FILE_READ_TIMEOUT_MS = 6000;
+
+int AsyncEG915U::openFile(const char *name, size_t &size) {
+  if (!at || !name || !*name) return -1;
+  if (!findUFSFile(name, nullptr, &size)) {
+    log_e("UFS file %s not found", name);
+    return -1;
+  }
+  // Mode 2: read-only
+  String resp;
+  if (!at->sendSync(String("AT+QFOPEN=\"") + name + "\",2", resp)) {
+    log_e("Failed to open UFS file %s", name);
+    return -1;
+  }
+  int pos = resp.indexOf("+QFOPEN:");
+  if (pos == -1) {
+    log_e("No file handle in AT+QFOPEN reply");
+    return -1;
+  }
+  int handle = resp.substring(pos + 8).toInt();
+  if (openFiles++ == 0) {
+    at->urc.registerEvent(FILE_DATA_URC, [this](const String &u) { onFileData(u); });
+    registeredURCPatterns.push_back(FILE_DATA_URC);
+  }
+  log_d("Opened UFS file %s as handle %d, %u bytes", name, handle, static_cast<unsigned>(size));
+  return handle;
+}
+
+int AsyncEG915U::readFile(int handle, uint8_t *buf, size_t len) {
+  if (!at || handle < 0 || !buf || len == 0) return -1;
+  xSemaphoreTake(fileReadMutex, portMAX_DELAY);
+  xSemaphoreTake(fileBufMutex, portMAX_DELAY);
+  fileRead.buf = buf;
+  fileRead.len = len;
+  fileRead.received = -1;
+  xSemaphoreGive(fileBufMutex);
+  // onFileData() reads the CONNECT reply into buf; the OK after it or an ERROR ends the promise
+  char cmd[32];
+  snprintf(cmd, sizeof(cmd), "AT+QFREAD=%d,%u", handle, static_cast<unsigned>(len));
+  ATPromise *promise = at->sendCommand(cmd);
+  bool ok = false;
+  if (promise) {
+    ok = promise->timeout(FILE_READ_TIMEOUT_MS)->wait();
+    at->popCompletedPromise(promise->getId());
+  }
+  // Waits out a reply still being written into buf before it goes out of scope
+  xSemaphoreTake(fileBufMutex, portMAX_DELAY);
+  int received = ok ? fileRead.received : -1;
+  fileRead.buf = nullptr;
+  fileRead.len = 0;
+  xSemaphoreGive(fileBufMutex);
+  xSemaphoreGive(fileReadMutex);
+  if (!ok) log_e("%s failed", cmd);
+  return received;
+}
+
+bool AsyncEG915U::seekFile(int handle, size_t offset) {
+  if (!at || handle < 0) return false;
+  return at->sendSync(
+      String("AT+QFSEEK=") + String(handle) + "," + String(static_cast<unsigned>(offset)) + ",0");
+}
+
+bool AsyncEG915U::closeFile(int handle) {
+  if (!at || handle < 0) return false;
+  bool ok = at->sendSync(String("AT+QFCLOSE=") + String(handle));
+  if (openFiles > 0 && --openFiles == 0) {
+    at->urc.unregisterEvent(FILE_DATA_URC);
+    auto it = std::find(
+        registeredURCPatterns.begin(), registeredURCPatterns.end(), String(FILE_DATA_URC));
+    if (it != registeredURCPatterns.end()) registeredURCPatterns.erase(it);
+  }
+  return ok;
+}
@@ -3,24 +3,77 @@
 #include <utils/GSMTransport/GSMTransport.h>
 #include <utils/MqttQueue/MqttQueue.h>
 
+#include <algorithm>
 #include <iomanip>
 #include <utility>
 #include <vector>
 
 #include "esp_log.h"
 
-static bool consumeOkResponse(Stream *stream) {
-  String tail = "";
-  while (stream->available()) {
-    int c = stream->read();
-    if (c >= 0) {
-      tail += (char)c;
-      if (tail.endsWith("OK\r\n")) { return true; }
-      // Prevent tail string from growing without bound
-      if (tail.length() > 8) { tail.remove(0, tail.length() - 8); }
+// Pulls len bytes into dst using bulk reads of whatever the stream has buffered.
+// Gives up once timeoutMs has elapsed since startTime; returns the number of bytes copied.
+static size_t readPayload(
+    Stream *stream, uint8_t *dst, size_t len, unsigned long startTime, unsigned long timeoutMs) {
+  size_t got = 0;
+  while (got < len) {
+    if (millis() - startTime > timeoutMs) break;
+    int ready = stream->available();
+    if (ready <= 0) {
+      vTaskDelay(1);
+      continue;
     }
+    size_t want = std::min(len - got, static_cast<size_t>(ready));
+    got += stream->readBytes(reinterpret_cast<char *>(dst + got), want);
+  }
+  return got;
+}
+
+// Consumes and drops len payload bytes so the AT parser stays aligned with the stream
+static size_t discardPayload(
+    Stream *stream, size_t len, unsigned long startTime, unsigned long timeoutMs) {
+  uint8_t scratch[64];
+  size_t dropped = 0;
+  while (dropped < len) {
+    size_t want = std::min(len - dropped, sizeof(scratch));
+    size_t got = readPayload(stream, scratch, want, startTime, timeoutMs);
+    dropped += got;
+    if (got < want) break;
   }
-  return false;
+  return dropped;
+}
+
+// The line reader ended an AT+QMTRECV reply at a CR LF inside the payload: the rest of the
+// payload is still on the stream, followed by the closing quote, and is read by its length
+static bool readSplitMqttPayload(
+    Stream *stream, std::vector<uint8_t> &payload, const uint8_t *head, size_t inLine,
+    size_t length, unsigned long timeoutMs) {
+  if (inLine + 2 > length) return false;
+  payload.resize(length);
+  std::copy(head, head + inLine, payload.begin());
+  payload[inLine] = '\r';
+  payload[inLine + 1] = '\n';
+  const unsigned long startTime = millis();
+  size_t rest = length - inLine - 2;
+  if (readPayload(stream, payload.data() + inLine + 2, rest, startTime, timeoutMs) < rest) {
+    return false;
+  }
+  uint8_t quote = 0;
+  return readPayload(stream, &quote, 1, startTime, timeoutMs) == 1 && quote == '"';
+}
+
+// Extracts the connectID from a socket URC. "+QIOPEN: <id>,<err>" carries it right after the
+// header, "+QIURC: \"recv\",<id>" after the quoted event name. A missing id means socket 0;
+// an out-of-range one yields -1.
+static int urcConnectId(const String &urc) {
+  int start = urc.lastIndexOf('"');
+  if (start == -1) start = urc.indexOf(':');
+  if (start == -1) return 0;
+  int pos = start + 1;
+  int len = urc.length();
+  while (pos < len && (urc.charAt(pos) == ',' || urc.charAt(pos) == ' ')) { pos++; }
+  if (pos >= len || !isDigit(urc.charAt(pos))) return 0;
+  int id = urc.substring(pos).toInt();
+  return id < EG915_MAX_SOCKETS ? id : -1;
 }
 
 void AsyncEG915U::registerURCs() {
@@ -31,11 +84,18 @@ void AsyncEG915U::registerURCs() {
     registeredURCPatterns.push_back(pattern);
   };
 
+  // Modem (re)started
+  reg("RDY", [this](const String &u) { onModemReady(u); });
+
   // Network registration
   reg("+CREG:", [this](const String &u) { onRegChanged(u); });
   reg("+CGREG:", [this](const String &u) { onRegChanged(u); });
   reg("+CEREG:", [this](const String &u) { onRegChanged(u); });
 
+  // Bring-up progress
+  reg("+CPIN:", [this](const String &u) { onSimState(u); });
+  reg("+CGEV:", [this](const String &u) { onPdpEvent(u); });
+
   // TCP/SSL open results
   reg("+QIOPEN:", [this](const String &u) { onOpenResult(u); });
   reg("+QSSLOPEN:", [this](const String &u) { onOpenResult(u); });
@@ -56,6 +116,9 @@ void AsyncEG915U::registerURCs() {
   // MQTT
   reg("+QMTRECV:", [this](const String &u) { onMqttRecv(u); });
   reg("+QMTSTAT:", [this](const String &u) { onMqttStat(u); });
+  reg("+QMTPUBEX:", [this](const String &u) { onMqttPubAck(u); });
+  reg("+QMTSUB:", [this](const String &u) { onMqttSubAck(u); });
+  reg("+QMTUNSUB:", [this](const String &u) { onMqttSubAck(u); });
 }
 
 void AsyncEG915U::unregisterURCs() {
@@ -64,23 +127,59 @@ void AsyncEG915U::unregisterURCs() {
   registeredURCPatterns.clear();
 }
 
-void AsyncEG915U::onRegChanged(const String &urc) {
-  String trimmed = urc;
+bool AsyncEG915U::parseRegStatus(const String &line, RegStatus &out) {
+  String trimmed = line;
   trimmed.trim();
-  int commaIndex = trimmed.indexOf(',');
-  if (commaIndex != -1) {
-    String statusStr = trimmed.substring(commaIndex + 1);
-    int endPos = statusStr.indexOf(',');
-    if (endPos != -1) statusStr = statusStr.substring(0, endPos);
-    URCState.creg.store((RegStatus)statusStr.toInt());
-    log_v("URC: Registration status updated to %d", URCState.creg.load());
+  int colon = trimmed.indexOf(':');
+  if (colon == -1) return false;
+  String fields = trimmed.substring(colon + 1);
+  fields.trim();
+  if (fields.length() == 0) return false;
+
+  // Solicited replies are "<n>,<stat>[,<lac>,<ci>...]"; unsolicited reports are
+  // "<stat>[,<lac>,<ci>...]" where the location fields are quoted
+  int firstComma = fields.indexOf(',');
+  String statusStr = fields;
+  if (firstComma != -1 && fields.charAt(firstComma + 1) != '"') {
+    statusStr = fields.substring(firstComma + 1);
   }
+  int endPos = statusStr.indexOf(',');
+  if (endPos != -1) statusStr = statusStr.substring(0, endPos);
+  statusStr.trim();
+  if (statusStr.length() == 0 || !isDigit(statusStr.charAt(0))) return false;
+  out = (RegStatus)statusStr.toInt();
+  return true;
+}
+
+void AsyncEG915U::onRegChanged(const String &urc) {
+  RegStatus status;
+  if (!parseRegStatus(urc, status)) return;
+  URCState.creg.store(status);
+  log_v("URC: Registration status updated to %d", URCState.creg.load());
+  if (urcSignal) { xSemaphoreGive(urcSignal); }
+}
+
+void AsyncEG915U::onSimState(const String &urc) {
+  bool ready = urc.indexOf("READY") != -1 && urc.indexOf("NOT READY") == -1;
+  URCState.simReady.store(ready);
+  log_d("URC: SIM %s", ready ? "ready" : "not ready");
+  if (urcSignal) { xSemaphoreGive(urcSignal); }
+}
+
+void AsyncEG915U::onPdpEvent(const String &urc) {
+  log_d("URC: %s", urc.c_str());
+  if (urcSignal) { xSemaphoreGive(urcSignal); }
 }
 
 void AsyncEG915U::onOpenResult(const String &urc) {
   String trimmed = urc;
   trimmed.trim();
-  if (transport) { transport->reset(); }
+  int connectId = urcConnectId(trimmed);
+  if (connectId < 0) {
+    log_e("URC: Open result for unknown connectID: %s", trimmed.c_str());
+    return;
+  }
+  if (GSMTransport *transport = transportFor(connectId)) { transport->reset(); }
   int firstComma = trimmed.indexOf(',');
   if (firstComma != -1) {
     String resultStr = trimmed.substring(firstComma + 1);
@@ -88,71 +187,121 @@ void AsyncEG915U::onOpenResult(const String &urc) {
     if (endPos != -1) resultStr = resultStr.substring(0, endPos);
     int result = resultStr.toInt();
     if (result == 0) {
-      URCState.isConnected.store(ConnectionStatus::CONNECTED);
-      log_d("URC: Connection opened successfully");
+      URCState.socketState[connectId].store(ConnectionStatus::CONNECTED);
+      log_d("URC: Connection %d opened successfully", connectId);
     } else {
-      URCState.isConnected.store(ConnectionStatus::FAILED);
-      log_e("URC: Connection failed with error %d", result);
+      URCState.socketState[connectId].store(ConnectionStatus::FAILED);
+      log_e("URC: Connection %d failed with error %d", connectId, result);
     }
   }
 }
 
-void AsyncEG915U::onClosed(const String & /*urc*/) {
-  URCState.isConnected.store(ConnectionStatus::CLOSING);
+void AsyncEG915U::onClosed(const String &urc) {
+  int connectId = urcConnectId(urc);
+  if (connectId < 0) return;
+  URCState.socketState[connectId].store(ConnectionStatus::CLOSING);
   // Prevents memory leaks
-  if (transport) { transport->reset(); }
-  log_d("URC: Connection closed");
+  dropPendingReads(static_cast<uint8_t>(connectId));
+  if (GSMTransport *transport = transportFor(connectId)) { transport->reset(); }
+  log_d("URC: Connection %d closed", connectId);
 }
 
-void AsyncEG915U::onTcpRecv(const String & /*urc*/) {
-  log_d("URC: Data received, ready to read with +QIRD");
-  if (transport) { transport->notifyDataReady(false); }
+void AsyncEG915U::onTcpRecv(const String &urc) {
+  int connectId = urcConnectId(urc);
+  log_d("URC: Data received on %d, ready to read with +QIRD", connectId);
+  if (GSMTransport *transport = transportFor(connectId)) { transport->notifyDataReady(false); }
 }
 
-void AsyncEG915U::onSslRecv(const String & /*urc*/) {
-  log_d("URC: SSL Data received, ready to read with +QSSLRECV");
-  if (transport) { transport->notifyDataReady(true); }
+void AsyncEG915U::onSslRecv(const String &urc) {
+  int connectId = urcConnectId(urc);
+  log_d("URC: SSL Data received on %d, ready to read with +QSSLRECV", connectId);
+  if (GSMTransport *transport = transportFor(connectId)) { transport->notifyDataReady(true); }
 }
 
 void AsyncEG915U::onReadData(const String &urc) {
+  // The reply has no connectID; replies arrive in the order the reads were requested
+  GSMTransport *transport = transportFor(popPendingRead());
   int headerStart = urc.indexOf(':');
   if (headerStart == -1) {
     log_e(">>>>>>>>>>>>URC: Failed to parse data length from +QIRD/+QSSLRECV");
-    if (transport) { transport->deliverChunk(std::vector<uint8_t>()); }
+    if (transport) { transport->finishChunk(0); }
     return;
   }
   String header = urc.substring(headerStart + 1);
   int remaining = header.toInt();
   if (remaining < 0) {
     log_e(">>>>>>>>>>>QIRD: Invalid length");
-    if (transport) { transport->deliverChunk(std::vector<uint8_t>()); }
+    if (transport) { transport->finishChunk(0); }
     return;
   }
   log_d("QIRD/QSSLRECV: Data length = %d", remaining);
-  std::vector<uint8_t> chunk;
-  chunk.reserve(remaining);
-  unsigned long startTime = millis();
+  Stream *stream = at->getStream();
+  const size_t length = static_cast<size_t>(remaining);
+  const unsigned long startTime = millis();
   const unsigned long timeout = 5000;
-  while (remaining > 0) {
-    if (millis() - startTime > timeout) {
-      log_e("Timeout reading data from modem");
+  size_t received = 0;
+  size_t consumed = 0;
+  bool timedOut = false;
+  bool stale = false;
+
+  // Read the payload straight into the transport's receive buffer (at most two regions). One
+  // token covers the whole reply, so a reset() between the regions cuts it off.
+  uint32_t token = transport ? transport->beginChunk() : 0;
+  while (transport && consumed < length) {
+    uint8_t *dst = nullptr;
+    size_t want = std::min(transport->reserveChunk(token, &dst), length - consumed);
+    if (want == 0) break;
+    size_t got = readPayload(stream, dst, want, startTime, timeout);
+    consumed += got;
+    if (!transport->commitChunk(token, got)) {
+      stale = true;
       break;
     }
-    if (!at->getStream()->available()) {
-      vTaskDelay(1);
-      continue;
+    received += got;
+    if (got < want) {
+      timedOut = true;
+      break;
     }
-    int c = at->getStream()->read();
-    if (c < 0) {
-      vTaskDelay(1);
-      continue;
+  }
+  if (!timedOut && consumed < length) {
+    if (stale) {
+      log_w("Socket reset while reading, dropping %zu bytes", length - received);
+    } else if (transport) {
+      log_e("Receive buffer full, dropping %zu bytes", length - consumed);
     }
-    chunk.push_back(static_cast<uint8_t>(c));
-    remaining--;
+    size_t dropped = discardPayload(stream, length - consumed, startTime, timeout);
+    timedOut = dropped < length - consumed;
+  }
+  if (timedOut) { log_e("Timeout reading data from modem"); }
+  // The OK that follows completes the request's promise
+  if (transport) { transport->finishChunk(received); }
+}
+
+void AsyncEG915U::onFileData(const String &urc) {
+  // CONNECT <length>, then the bytes and OK
+  int space = urc.indexOf(' ');
+  int remaining = space == -1 ? -1 : urc.substring(space + 1).toInt();
+  if (remaining < 0) {
+    log_e("URC: Failed to parse AT+QFREAD length");
+    return;
+  }
+  Stream *stream = at->getStream();
+  const size_t length = static_cast<size_t>(remaining);
+  const unsigned long startTime = millis();
+  const unsigned long timeout = 5000;
+  // Held until the payload is in: a reader that timed out cannot release buf meanwhile
+  xSemaphoreTake(fileBufMutex, portMAX_DELAY);
+  size_t want = fileRead.buf ? std::min(length, fileRead.len) : 0;
+  size_t received = want ? readPayload(stream, fileRead.buf, want, startTime, timeout) : 0;
+  bool complete = received == want;
+  if (complete && length > want) {
+    log_e("Dropping %u bytes of AT+QFREAD nobody asked for", static_cast<unsigned>(length - want));
+    complete = discardPayload(stream, length - want, startTime, timeout) == length - want;
   }
-  consumeOkResponse(at->getStream());
-  log_v("Chunk: %.*s", chunk.size(), (char *)chunk.data());
-  if (transport) { transport->deliverChunk(std::move(chunk)); }
+  if (!complete) { log_e("Timeout reading file data from modem"); }
+  fileRead.received = complete ? static_cast<int>(received) : -1;
+  xSemaphoreGive(fileBufMutex);
+  // The OK that follows completes readFile()'s promise
 }
 
 void AsyncEG915U::onMqttRecv(const String &urc) {
@@ -175,14 +324,26 @@ void AsyncEG915U::onMqttRecv(const String &urc) {
   msgId.trim();
   log_d("URC: MQTT message for client %d on topic ID %d", clientId.toInt(), msgId.toInt());
   if (commaCount <= 1) {
-    // QMTRECV=<client>,<msgid>
-    at->getStream()->print("AT+QMTRECV=" + clientId + "," + msgId + "\r\n");
-    at->getStream()->flush();
-    return;
-  }
-
-  if (!mqttQueueSub) {
-    log_w("URC: MQTT message received but mqttQueueSub is not set");
+    // +QMTRECV: <client>,<recv_id>: the message waits in the modem's buffer. Writing
+    // AT+QMTRECV from the reader task could land after another command's > prompt, so the
+    // notice is only recorded for fetchMqttMessage().
+    long client = clientId.toInt();
+    long recvId = msgId.toInt();
+    if (msgId.length() == 0 || client < 0 || client >= EG915_MQTT_CLIENTS || recvId > 0xFF) {
+      log_e("URC: Invalid +QMTRECV notice");
+      return;
+    }
+    MqttFetch fetch{static_cast<uint8_t>(client), static_cast<uint8_t>(recvId)};
+    xSemaphoreTake(mqttFetchMutex, portMAX_DELAY);
+    bool known = std::any_of(mqttFetches.begin(), mqttFetches.end(), [&](const MqttFetch &f) {
+      return f.client == fetch.client && f.recvId == fetch.recvId;
+    });
+    if (!known) mqttFetches.push_back(fetch);
+    xSemaphoreGive(mqttFetchMutex);
+    // A dispatch task waiting on the queue does the fetch
+    xSemaphoreTake(mqttQueueMutex, portMAX_DELAY);
+    if (mqttQueueSub) mqttQueueSub->wake();
+    xSemaphoreGive(mqttQueueMutex);
     return;
   }
 
@@ -202,39 +363,145 @@ void AsyncEG915U::onMqttRecv(const String &urc) {
     log_e("URC: Failed to find topic end quote");
     return;
   }
-  String topic = urc.substring(topicStart + 1, topicEnd);
-  int payloadStart = urc.indexOf('"', topicEnd + 1);
-  if (payloadStart == -1) {
-    log_e("URC: Failed to find payload start quote");
-    return;
-  }
-  int payloadEnd = urc.lastIndexOf('"');
-  if (payloadEnd <= payloadStart) {
-    log_e("URC: Failed to find payload end quote");
-    return;
-  }
-  String payload = urc.substring(payloadStart + 1, payloadEnd);
-  log_w("URC: Topic: '%s', Payload: '%s'", topic.c_str(), payload.c_str());
 
-  MqttMessage msg;
-  msg.topic = topic;
-  msg.payload.clear();
-  msg.payload.reserve(payload.length());
-  for (int i = 0; i < payload.length(); i++) {
-    msg.payload.push_back(static_cast<uint8_t>(payload.charAt(i)));
+  // Reused across messages; the queue hands back a recycled buffer on every push
+  MqttMessage &msg = mqttRxScratch;
+  msg.topic = urc.substring(topicStart + 1, topicEnd);
+
+  // With lengths enabled: <client>,<msgid>,"<topic>",<payload_len>,"<payload>". The line ends
+  // early when the payload holds a line break; the length says how much is left to read.
+  if (urc.charAt(topicEnd + 1) == ',' && isDigit(urc.charAt(topicEnd + 2))) {
+    long length = urc.substring(topicEnd + 2).toInt();
+    int payloadStart = urc.indexOf('"', topicEnd + 2);
+    if (length < 0 || payloadStart == -1) {
+      log_e("URC: Malformed +QMTRECV payload, dropping message");
+      return;
+    }
+    const uint8_t *begin = reinterpret_cast<const uint8_t *>(urc.c_str()) + payloadStart + 1;
+    size_t inLine = urc.length() - payloadStart - 1;
+    if (inLine >= static_cast<size_t>(length)) {
+      msg.payload.assign(begin, begin + length);
+    } else if (!readSplitMqttPayload(
+                   at->getStream(), msg.payload, begin, inLine, static_cast<size_t>(length),
+                   MQTT_RECV_TIMEOUT_MS)) {
+      log_e("URC: Incomplete +QMTRECV payload, dropping message");
+      return;
+    }
+    msg.length = msg.payload.size();
+  } else {
+    int payloadStart = urc.indexOf('"', topicEnd + 1);
+    if (payloadStart == -1) {
+      log_e("URC: Failed to find payload start quote");
+      return;
+    }
+    int payloadEnd = urc.lastIndexOf('"');
+    if (payloadEnd <= payloadStart) {
+      log_e("URC: Failed to find payload end quote");
+      return;
+    }
+    const uint8_t *begin = reinterpret_cast<const uint8_t *>(urc.c_str()) + payloadStart + 1;
+    msg.payload.assign(begin, begin + (payloadEnd - payloadStart - 1));
+    msg.length = msg.payload.size();
   }
-  msg.length = msg.payload.size();
+  // The OK after a reply to AT+QMTRECV completes fetchMqttMessage()'s promise
+  queueMqttMessage(msg);
+}
 
-  if (mqttQueueSub->push(msg, pdMS_TO_TICKS(10))) {
-    log_d("URC: MQTT message queued, payload length %d", msg.length);
+void AsyncEG915U::queueMqttMessage(MqttMessage &msg) {
+  log_d("URC: MQTT message on '%s', %u bytes", msg.topic.c_str(), msg.length);
+  xSemaphoreTake(mqttQueueMutex, portMAX_DELAY);
+  if (!mqttQueueSub) {
+    log_w("URC: MQTT message received but mqttQueueSub is not set");
+  } else if (mqttQueueSub->push(std::move(msg), pdMS_TO_TICKS(10))) {
+    log_d("URC: MQTT message queued");
   } else {
     log_e("URC: MQTT queue full - dropping message");
   }
+  xSemaphoreGive(mqttQueueMutex);
+}
 
-  consumeOkResponse(at->getStream());
+bool AsyncEG915U::fetchMqttMessage(uint8_t client) {
+  if (!at) return false;
+  xSemaphoreTake(mqttFetchMutex, portMAX_DELAY);
+  auto it = std::find_if(mqttFetches.begin(), mqttFetches.end(), [client](const MqttFetch &f) {
+    return f.client == client;
+  });
+  bool found = it != mqttFetches.end();
+  MqttFetch fetch{};
+  if (found) {
+    fetch = *it;
+    mqttFetches.erase(it);
+  }
+  xSemaphoreGive(mqttFetchMutex);
+  if (!found) return false;
+
+  // The reply reaches onMqttRecv() like a pushed message and is queued there
+  char cmd[24];
+  snprintf(cmd, sizeof(cmd), "AT+QMTRECV=%u,%u", client, fetch.recvId);
+  ATPromise *promise = at->sendCommand(cmd);
+  if (!promise) {
+    log_e("Failed to send %s", cmd);
+    return true;
+  }
+  bool ok = promise->timeout(MQTT_RECV_TIMEOUT_MS)->wait();
+  at->popCompletedPromise(promise->getId());
+  if (!ok) { log_e("%s failed, message dropped", cmd); }
+  return true;
 }
 
 void AsyncEG915U::onMqttStat(const String & /*urc*/) {
   log_w("URC: +QMTSTAT received");
   URCState.mqttState.store(MqttConnectionState::DISCONNECTED);
+  // The modem's receive buffer went with the session
+  xSemaphoreTake(mqttFetchMutex, portMAX_DELAY);
+  mqttFetches.clear();
+  xSemaphoreGive(mqttFetchMutex);
+  // Acks for anything still in flight will never arrive on this session
+  if (mqttPublishWindow) { mqttPublishWindow->failAll(); }
+}
+
+void AsyncEG915U::onMqttPubAck(const String &urc) {
+  // +QMTPUBEX: <client_idx>,<msgID>,<result>[,<value>]
+  int colon = urc.indexOf(':');
+  int first = urc.indexOf(',', colon + 1);
+  int second = first == -1 ? -1 : urc.indexOf(',', first + 1);
+  if (colon == -1 || second == -1) {
+    log_e("URC: Failed to parse +QMTPUBEX");
+    return;
+  }
+  long msgId = urc.substring(first + 1, second).toInt();
+  int result = urc.substring(second + 1).toInt();
+  log_d("URC: MQTT publish %ld result %d", msgId, result);
+  if (mqttPublishWindow && msgId > 0 && msgId <= 0xFFFF) {
+    mqttPublishWindow->complete(static_cast<uint16_t>(msgId), result);
+  }
+}
+
+void AsyncEG915U::onMqttSubAck(const String &urc) {
+  // +QMTSUB: <client_idx>,<msgID>,<result>[,<value>[,<value>...]]; +QMTUNSUB has no values
+  int colon = urc.indexOf(':');
+  int first = urc.indexOf(',', colon + 1);
+  int second = first == -1 ? -1 : urc.indexOf(',', first + 1);
+  if (colon == -1 || second == -1) {
+    log_e("URC: Failed to parse +QMTSUB");
+    return;
+  }
+  long msgId = urc.substring(first + 1, second).toInt();
+  int result = urc.substring(second + 1).toInt();
+  // On success each value is the QoS granted to one filter, 128 when the broker refused it
+  for (int comma = urc.indexOf(',', second + 1); result == 0 && comma != -1;
+       comma = urc.indexOf(',', comma + 1)) {
+    if (urc.substring(comma + 1).toInt() == 128) result = 2;
+  }
+  log_d("URC: MQTT subscribe %ld result %d", msgId, result);
+  if (mqttPublishWindow && msgId > 0 && msgId <= 0xFFFF) {
+    mqttPublishWindow->complete(static_cast<uint16_t>(msgId), result);
+  }
+}
+
+void AsyncEG915U::onModemReady(const String & /*urc*/) {
+  log_w("URC: modem restarted");
+  invalidateConfigCache();
+  // The SIM is read again after a restart; +CPIN: READY reports it once it is
+  URCState.simReady.store(false);
 }
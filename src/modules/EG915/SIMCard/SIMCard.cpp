@@ -108,6 +108,13 @@ EG915SimSlot EG915SIMCard::getCurrentSlot() {
   return currentSlot;
 }
 
+bool EG915SIMCard::updateSlotFrom(const String &resp) {
+  EG915SimSlot slot;
+  if (!parseQDSIM(resp, slot)) return false;
+  currentSlot = slot;
+  return true;
+}
+
 bool EG915SIMCard::setSlot(EG915SimSlot slot) {
   if (!at) return false;
   if (slot != EG915SimSlot::SLOT_1 && slot != EG915SimSlot::SLOT_2) return false;
@@ -17,6 +17,9 @@ class EG915SIMCard {
 
   EG915SimSlot getCurrentSlot();
   bool setSlot(EG915SimSlot slot);
+  // Refreshes the cached slot from a reply that contains a +QDSIM: line, without a query
+  bool updateSlotFrom(const String &resp);
+  EG915SimSlot cachedSlot() const { return currentSlot; }
 
  private:
   AsyncATHandler *at{nullptr};
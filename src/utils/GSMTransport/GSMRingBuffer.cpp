@@ -0,0 +1,83 @@
+#include "GSMRingBuffer.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+
+GSMRingBuffer::GSMRingBuffer(size_t capacity) { setCapacity(capacity); }
+
+bool GSMRingBuffer::setCapacity(size_t capacity) {
+  if (capacity == 0) return false;
+  std::unique_ptr<uint8_t[]> fresh(new (std::nothrow) uint8_t[capacity]);
+  if (!fresh) return false;
+  storage = std::move(fresh);
+  cap = capacity;
+  clear();
+  return true;
+}
+
+size_t GSMRingBuffer::size() const {
+  return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+size_t GSMRingBuffer::space() const { return cap - size(); }
+
+void GSMRingBuffer::clear() {
+  head.store(0, std::memory_order_release);
+  tail.store(0, std::memory_order_release);
+}
+
+size_t GSMRingBuffer::write(const uint8_t *data, size_t len) {
+  if (!data || len == 0 || !storage) return 0;
+  size_t h = head.load(std::memory_order_relaxed);
+  size_t t = tail.load(std::memory_order_acquire);
+  size_t n = std::min(len, cap - (h - t));
+  if (n == 0) return 0;
+
+  size_t offset = h % cap;
+  size_t first = std::min(n, cap - offset);
+  memcpy(storage.get() + offset, data, first);
+  if (n > first) { memcpy(storage.get(), data + first, n - first); }
+
+  head.store(h + n, std::memory_order_release);
+  return n;
+}
+
+size_t GSMRingBuffer::read(uint8_t *out, size_t len) {
+  if (!out || len == 0 || !storage) return 0;
+  size_t t = tail.load(std::memory_order_relaxed);
+  size_t h = head.load(std::memory_order_acquire);
+  size_t n = std::min(len, h - t);
+  if (n == 0) return 0;
+
+  size_t offset = t % cap;
+  size_t first = std::min(n, cap - offset);
+  memcpy(out, storage.get() + offset, first);
+  if (n > first) { memcpy(out + first, storage.get(), n - first); }
+
+  tail.store(t + n, std::memory_order_release);
+  return n;
+}
+
+int GSMRingBuffer::peek() const {
+  size_t t = tail.load(std::memory_order_relaxed);
+  if (head.load(std::memory_order_acquire) == t) return -1;
+  return storage[t % cap];
+}
+
+size_t GSMRingBuffer::writableRegion(uint8_t **ptr) {
+  if (!ptr) return 0;
+  *ptr = nullptr;
+  if (!storage) return 0;
+  size_t h = head.load(std::memory_order_relaxed);
+  size_t t = tail.load(std::memory_order_acquire);
+  size_t offset = h % cap;
+  *ptr = storage.get() + offset;
+  return std::min(cap - (h - t), cap - offset);
+}
+
+void GSMRingBuffer::commit(size_t len) {
+  size_t h = head.load(std::memory_order_relaxed);
+  head.store(h + std::min(len, space()), std::memory_order_release);
+}
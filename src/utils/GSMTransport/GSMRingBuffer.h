@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+// Fixed-capacity byte FIFO backed by a single contiguous allocation.
+// One producer and one consumer may run concurrently without a lock; clear() and setCapacity()
+// must not race with either side.
+class GSMRingBuffer {
+ public:
+  static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+  explicit GSMRingBuffer(size_t capacity = DEFAULT_CAPACITY);
+
+  // Reallocates the storage; any buffered bytes are discarded
+  bool setCapacity(size_t capacity);
+  size_t capacity() const { return cap; }
+
+  size_t size() const;
+  size_t space() const;
+  bool empty() const { return size() == 0; }
+  void clear();
+
+  // Copies up to len bytes in/out with at most two memcpy calls; returns bytes moved
+  size_t write(const uint8_t *data, size_t len);
+  size_t read(uint8_t *out, size_t len);
+  int peek() const;
+
+  // Zero-copy producer access: exposes the contiguous free region at the write position.
+  // Bytes placed there become visible to the consumer only once commit() is called.
+  size_t writableRegion(uint8_t **ptr);
+  void commit(size_t len);
+
+ private:
+  std::unique_ptr<uint8_t[]> storage;
+  size_t cap{0};
+  // Monotonic byte counters; the difference is the fill level even after wrap-around
+  std::atomic<size_t> head{0};
+  std::atomic<size_t> tail{0};
+};
@@ -6,9 +6,12 @@
 
 GSMTransport::GSMTransport() {}
 
-void GSMTransport::init(Stream &s, SemaphoreHandle_t mutex) {
+void GSMTransport::init(
+    Stream &s, SemaphoreHandle_t mutex, uint8_t socket, GSMReadRequester *readRequester) {
   stream = &s;
   rxMutex = mutex;
+  socketId = socket;
+  requester = readRequester;
   reset();
 }
 
@@ -17,8 +20,12 @@ void GSMTransport::reset() {
   buffer.clear();
   pendingChannels.clear();
   awaitingChunk = false;
+  // fillingChunk stays set: the parser may still be writing into the region it reserved, and
+  // clears it with finishChunk()
+  ++generation;
   autopollPending = false;
   lastChannel = defaultChannel;
+  inflightSize = requestSize;
   unlock();
 }
 
@@ -29,6 +36,94 @@ void GSMTransport::setDefaultSSL(bool enabled) {
   unlock();
 }
 
+bool GSMTransport::setBufferCapacity(size_t capacity) {
+  lock();
+  if (awaitingChunk || fillingChunk) {
+    // The outstanding reply may not fit a smaller buffer, and reallocating would pull the
+    // storage out from under a payload being read
+    unlock();
+    log_w("GSMTransport %u busy receiving, buffer not resized", socketId);
+    return false;
+  }
+  bool ok = buffer.setCapacity(capacity < MIN_CHUNK_SIZE ? MIN_CHUNK_SIZE : capacity);
+  requestSize = clampChunkSize(requestSize);
+  inflightSize = requestSize;
+  unlock();
+  if (!ok) { log_e("GSMTransport failed to allocate %zu byte buffer", capacity); }
+  return ok;
+}
+
+size_t GSMTransport::bufferCapacity() {
+  lock();
+  size_t cap = buffer.capacity();
+  unlock();
+  return cap;
+}
+
+void GSMTransport::setReadAheadWatermark(size_t bytes) {
+  lock();
+  watermark = bytes;
+  unlock();
+  maybeRequestNext();
+}
+
+size_t GSMTransport::readAheadWatermark() {
+  lock();
+  size_t value = watermark;
+  unlock();
+  return value;
+}
+
+size_t GSMTransport::clampChunkSize(size_t bytes) const {
+  // A request larger than the ring could never be issued
+  size_t upper = buffer.capacity() < MAX_CHUNK_SIZE ? buffer.capacity() : MAX_CHUNK_SIZE;
+  if (bytes > upper) bytes = upper;
+  if (bytes < MIN_CHUNK_SIZE) bytes = MIN_CHUNK_SIZE;
+  return bytes;
+}
+
+void GSMTransport::setChunkSize(size_t bytes) {
+  lock();
+  requestSize = clampChunkSize(bytes);
+  if (!awaitingChunk) { inflightSize = requestSize; }
+  unlock();
+}
+
+size_t GSMTransport::chunkSize() {
+  lock();
+  size_t value = requestSize;
+  unlock();
+  return value;
+}
+
+void GSMTransport::setAdaptiveChunkSize(bool enabled) {
+  lock();
+  adaptive = enabled;
+  unlock();
+}
+
+void GSMTransport::adaptChunkSizeLocked(size_t total) {
+  if (!adaptive) return;
+  if (total >= inflightSize) {
+    requestSize = clampChunkSize(inflightSize * 2);
+  } else if (total < inflightSize / 4) {
+    requestSize = clampChunkSize(inflightSize / 2);
+  }
+}
+
+void GSMTransport::beginRequestLocked(Channel ch) {
+  awaitingChunk = true;
+  autopollPending = false;
+  lastChannel = ch;
+  inflightSize = requestSize;
+}
+
+bool GSMTransport::canRequestLocked() const {
+  if (awaitingChunk) return false;
+  // Read ahead while the application drains the buffer, but never ask for more than fits
+  return buffer.size() <= watermark && buffer.space() >= requestSize;
+}
+
 void GSMTransport::lock() {
   if (rxMutex) { xSemaphoreTake(rxMutex, portMAX_DELAY); }
 }
@@ -37,16 +132,20 @@ void GSMTransport::unlock() {
   if (rxMutex) { xSemaphoreGive(rxMutex); }
 }
 
-void GSMTransport::requestChannel(Channel ch) {
-  if (!stream) return;
-  lastChannel = ch;
-  if (ch == Channel::SSL) {
-    log_d("GSMTransport requesting SSL chunk");
-    stream->print("AT+QSSLRECV=0,1500\r\n");
-  } else {
-    log_d("GSMTransport requesting TCP chunk");
-    stream->print("AT+QIRD=0\r\n");
+void GSMTransport::requestChannel(Channel ch, size_t len) {
+  log_d(
+      "GSMTransport %u requesting %zu byte %s chunk", socketId, len,
+      ch == Channel::SSL ? "SSL" : "TCP");
+  if (requester) {
+    requester->requestRead(socketId, ch == Channel::SSL, len);
+    return;
   }
+  if (!stream) return;
+  char cmd[32];
+  snprintf(
+      cmd, sizeof(cmd), ch == Channel::SSL ? "AT+QSSLRECV=%u,%u\r\n" : "AT+QIRD=%u,%u\r\n",
+      socketId, static_cast<unsigned>(len));
+  stream->print(cmd);
   stream->flush();
 }
 
@@ -55,23 +154,21 @@ void GSMTransport::maybeRequestNext() {
   bool shouldRequest = false;
 
   lock();
-  if (!awaitingChunk && buffer.empty()) {
+  if (canRequestLocked()) {
     if (!pendingChannels.empty()) {
       nextChannel = pendingChannels.front();
       pendingChannels.pop_front();
-      awaitingChunk = true;
       shouldRequest = true;
-      autopollPending = false;
     } else if (autopollPending) {
-      awaitingChunk = true;
       shouldRequest = true;
-      autopollPending = false;
       nextChannel = lastChannel;
     }
   }
+  if (shouldRequest) { beginRequestLocked(nextChannel); }
+  size_t len = inflightSize;
   unlock();
 
-  if (shouldRequest) { requestChannel(nextChannel); }
+  if (shouldRequest) { requestChannel(nextChannel, len); }
 }
 
 void GSMTransport::notifyDataReady(bool isSSL) {
@@ -81,34 +178,52 @@ void GSMTransport::notifyDataReady(bool isSSL) {
   unlock();
 }
 
-void GSMTransport::deliverChunk(std::vector<uint8_t> &&chunk) {
-  Channel nextChannel = defaultChannel;
-  bool shouldRequest = false;
-  bool enableAutopoll = false;
+uint32_t GSMTransport::beginChunk() {
+  lock();
+  fillingChunk = true;
+  uint32_t token = generation;
+  unlock();
+  return token;
+}
 
+size_t GSMTransport::reserveChunk(uint32_t token, uint8_t **dst) {
   lock();
-  awaitingChunk = false;
-  if (!chunk.empty()) { buffer.insert(buffer.end(), chunk.begin(), chunk.end()); }
-  if (chunk.size() >= MAX_CHUNK_SIZE) { enableAutopoll = true; }
-  if (buffer.empty()) {
-    if (!pendingChannels.empty()) {
-      nextChannel = pendingChannels.front();
-      pendingChannels.pop_front();
-      awaitingChunk = true;
-      shouldRequest = true;
-      autopollPending = false;
-    } else if (enableAutopoll) {
-      awaitingChunk = true;
-      shouldRequest = true;
-      autopollPending = false;
-      nextChannel = lastChannel;
+  size_t room = token == generation ? buffer.writableRegion(dst) : 0;
+  unlock();
+  return room;
+}
+
+bool GSMTransport::commitChunk(uint32_t token, size_t len) {
+  lock();
+  // A reset() while the payload was being read invalidates the rest of the reply
+  bool current = token == generation;
+  if (current) { buffer.commit(len); }
+  unlock();
+  return current;
+}
+
+void GSMTransport::deliverChunk(std::vector<uint8_t> &&chunk) {
+  if (!chunk.empty()) {
+    lock();
+    size_t stored = buffer.write(chunk.data(), chunk.size());
+    unlock();
+    if (stored < chunk.size()) {
+      log_e("GSMTransport buffer full, dropped %zu bytes", chunk.size() - stored);
     }
-  } else if (enableAutopoll) {
-    autopollPending = true;
   }
-  unlock();
+  finishChunk(chunk.size());
+}
 
-  if (shouldRequest) { requestChannel(nextChannel); }
+void GSMTransport::finishChunk(size_t total) {
+  lock();
+  awaitingChunk = false;
+  fillingChunk = false;
+  // A reply that filled the whole request means the modem probably holds more data
+  if (total >= inflightSize) { autopollPending = true; }
+  adaptChunkSizeLocked(total);
+  unlock();
+  // Called on the URC reader task: the next request is left to available()/read(), since
+  // sending it from here could block the reader on the AT handler it is feeding
 }
 
 size_t GSMTransport::available() {
@@ -130,14 +245,10 @@ size_t GSMTransport::read(uint8_t *buf, size_t size) {
   if (!buf || size == 0) return 0;
 
   lock();
-  size_t toCopy = std::min<size_t>(size, buffer.size());
-  for (size_t i = 0; i < toCopy; ++i) {
-    buf[i] = buffer.front();
-    buffer.pop_front();
-  }
+  size_t toCopy = buffer.read(buf, size);
   bool needRequest = false;
   bool autopollNeeded = false;
-  if (buffer.empty() && !awaitingChunk) {
+  if (canRequestLocked()) {
     needRequest = !pendingChannels.empty();
     autopollNeeded = autopollPending;
   }
@@ -151,7 +262,7 @@ size_t GSMTransport::read(uint8_t *buf, size_t size) {
 int GSMTransport::peek() {
   lock();
   if (buffer.empty()) {
-    bool trigger = !awaitingChunk && !pendingChannels.empty();
+    bool trigger = !awaitingChunk && (!pendingChannels.empty() || autopollPending);
     unlock();
     if (trigger) {
       maybeRequestNext();
@@ -165,7 +276,7 @@ int GSMTransport::peek() {
     unlock();
     return -1;
   }
-  int value = buffer.front();
+  int value = buffer.peek();
   unlock();
   return value;
 }
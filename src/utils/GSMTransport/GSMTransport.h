@@ -6,18 +6,61 @@
 #include <deque>
 #include <vector>
 
+#include "GSMRingBuffer.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 
+// Sends chunk requests on behalf of a transport. The modem driver implements this so it can
+// remember which socket each +QIRD/+QSSLRECV reply belongs to, since the reply carries no id.
+class GSMReadRequester {
+ public:
+  virtual ~GSMReadRequester() {}
+  virtual void requestRead(uint8_t socketId, bool ssl, size_t len) = 0;
+};
+
 class GSMTransport {
  public:
   GSMTransport();
 
-  void init(Stream &stream, SemaphoreHandle_t mutex);
+  // Without a requester the read commands are written straight to the stream
+  void init(
+      Stream &stream, SemaphoreHandle_t mutex, uint8_t socketId = 0,
+      GSMReadRequester *requester = nullptr);
+  uint8_t socket() const { return socketId; }
   void reset();
   void setDefaultSSL(bool enabled);
+  // Resizes the receive buffer (at least MIN_CHUNK_SIZE); drops any buffered bytes. Small buffers
+  // cap the chunk size, which suits links that only carry short messages. Refused (false) while
+  // a chunk is requested or being read into the buffer: its reply was sized for the old one.
+  bool setBufferCapacity(size_t capacity);
+  size_t bufferCapacity();
+  // The next chunk is requested once no more than this many bytes remain buffered, provided a
+  // whole chunk still fits. 0 waits for the buffer to drain completely before asking again.
+  void setReadAheadWatermark(size_t bytes);
+  size_t readAheadWatermark();
+  // Length requested per AT+QIRD/AT+QSSLRECV, clamped to [MIN_CHUNK_SIZE, MAX_CHUNK_SIZE] and to
+  // the buffer capacity.
+  // In adaptive mode it doubles while the modem keeps filling whole chunks and halves when
+  // replies come back mostly empty.
+  void setChunkSize(size_t bytes);
+  size_t chunkSize();
+  void setAdaptiveChunkSize(bool enabled);
+
+  static constexpr size_t MIN_CHUNK_SIZE = 64;
+  static constexpr size_t MAX_CHUNK_SIZE = 1500;
 
   void notifyDataReady(bool isSSL);
+
+  // Zero-copy delivery: the URC parser takes a token for the reply with beginChunk(), reads the
+  // payload straight into the free regions returned by reserveChunk(), publishes them with
+  // commitChunk() and closes the chunk with finishChunk(). A reset() makes the token stale:
+  // reserveChunk() then offers no room and commitChunk() refuses (false).
+  // finishChunk() never sends the next request itself; available() and read() do.
+  uint32_t beginChunk();
+  size_t reserveChunk(uint32_t token, uint8_t **dst);
+  bool commitChunk(uint32_t token, size_t len);
+  void finishChunk(size_t total);
+  // Copying variant for callers that already hold the payload
   void deliverChunk(std::vector<uint8_t> &&chunk);
 
   size_t available();
@@ -32,16 +75,29 @@ class GSMTransport {
   void lock();
   void unlock();
   void maybeRequestNext();
-  void requestChannel(Channel ch);
+  bool canRequestLocked() const;
+  void adaptChunkSizeLocked(size_t total);
+  size_t clampChunkSize(size_t bytes) const;
+  void beginRequestLocked(Channel ch);
+  void requestChannel(Channel ch, size_t len);
 
   Stream *stream{nullptr};
   SemaphoreHandle_t rxMutex{nullptr};
-  std::deque<uint8_t> buffer;
+  GSMReadRequester *requester{nullptr};
+  uint8_t socketId{0};
+  GSMRingBuffer buffer;
   std::deque<Channel> pendingChannels;
   bool awaitingChunk{false};
+  bool fillingChunk{false};
+  // Bumped by reset() so commits of reservations made before it are ignored
+  uint32_t generation{0};
   Channel defaultChannel{Channel::TCP};
   Channel lastChannel{Channel::TCP};
   bool autopollPending{false};
 
-  static constexpr size_t MAX_CHUNK_SIZE = 1500;
+  size_t watermark{MAX_CHUNK_SIZE};
+  size_t requestSize{MAX_CHUNK_SIZE};
+  // Length asked for by the outstanding (or most recent) request
+  size_t inflightSize{MAX_CHUNK_SIZE};
+  bool adaptive{false};
 };
@@ -0,0 +1,156 @@
+#include "MqttPublishWindow.h"
+
+#include "esp_log.h"
+
+MqttPublishWindow::MqttPublishWindow() {
+  mutex = xSemaphoreCreateMutex();
+  tokens = xSemaphoreCreateCounting(MAX_WINDOW, DEFAULT_WINDOW);
+  for (auto &slot : slots) { slot.done = xSemaphoreCreateBinary(); }
+}
+
+MqttPublishWindow::~MqttPublishWindow() {
+  for (auto &slot : slots) {
+    if (slot.done) vSemaphoreDelete(slot.done);
+  }
+  if (tokens) vSemaphoreDelete(tokens);
+  if (mutex) vSemaphoreDelete(mutex);
+}
+
+bool MqttPublishWindow::setWindow(uint8_t size) {
+  if (size == 0) size = 1;
+  if (size > MAX_WINDOW) size = MAX_WINDOW;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (pending > 0) {
+    xSemaphoreGive(mutex);
+    log_w("Cannot resize publish window with %u messages in flight", pending);
+    return false;
+  }
+  // With nothing in flight every token is available
+  while (windowSize < size) {
+    xSemaphoreGive(tokens);
+    windowSize++;
+  }
+  while (windowSize > size) {
+    xSemaphoreTake(tokens, 0);
+    windowSize--;
+  }
+  xSemaphoreGive(mutex);
+  return true;
+}
+
+uint8_t MqttPublishWindow::inFlight() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint8_t count = pending;
+  xSemaphoreGive(mutex);
+  return count;
+}
+
+MqttPublishWindow::Slot *MqttPublishWindow::findLocked(uint16_t msgId) {
+  for (auto &slot : slots) {
+    if (slot.state != SlotState::FREE && slot.msgId == msgId) return &slot;
+  }
+  return nullptr;
+}
+
+bool MqttPublishWindow::idInUseLocked(uint16_t msgId) { return findLocked(msgId) != nullptr; }
+
+int MqttPublishWindow::acquire(uint32_t timeoutMs) {
+  if (xSemaphoreTake(tokens, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+    log_w("Publish window full for %u ms", static_cast<unsigned>(timeoutMs));
+    return -1;
+  }
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  // Prefer an unused slot, otherwise recycle the oldest unclaimed result
+  Slot *target = nullptr;
+  for (auto &slot : slots) {
+    if (slot.state == SlotState::FREE) {
+      target = &slot;
+      break;
+    }
+    if (slot.state != SlotState::PENDING && (!target || slot.seq < target->seq)) {
+      target = &slot;
+    }
+  }
+
+  uint16_t id = nextId;
+  while (idInUseLocked(id)) { id = id == 0xFFFF ? 1 : id + 1; }
+  nextId = id == 0xFFFF ? 1 : id + 1;
+
+  target->msgId = id;
+  target->state = SlotState::PENDING;
+  xSemaphoreTake(target->done, 0);
+  pending++;
+  xSemaphoreGive(mutex);
+  return id;
+}
+
+void MqttPublishWindow::finishLocked(Slot &slot, SlotState state) {
+  slot.state = state;
+  slot.seq = ++seqCounter;
+  pending--;
+  xSemaphoreGive(tokens);
+  xSemaphoreGive(slot.done);
+}
+
+void MqttPublishWindow::cancel(uint16_t msgId) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  Slot *slot = findLocked(msgId);
+  if (slot && slot->state == SlotState::PENDING) {
+    slot->state = SlotState::FREE;
+    pending--;
+    xSemaphoreGive(tokens);
+  }
+  xSemaphoreGive(mutex);
+}
+
+void MqttPublishWindow::complete(uint16_t msgId, int result) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  Slot *slot = findLocked(msgId);
+  if (!slot || slot->state != SlotState::PENDING) {
+    log_d("Ignoring publish result for untracked msgId %u", msgId);
+  } else if (result == 1) {
+    log_d("Publish %u is being retransmitted", msgId);
+  } else {
+    finishLocked(*slot, result == 0 ? SlotState::DELIVERED : SlotState::FAILED);
+  }
+  xSemaphoreGive(mutex);
+}
+
+void MqttPublishWindow::failAll() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  for (auto &slot : slots) {
+    if (slot.state == SlotState::PENDING) { finishLocked(slot, SlotState::FAILED); }
+  }
+  xSemaphoreGive(mutex);
+}
+
+bool MqttPublishWindow::wait(uint16_t msgId, uint32_t timeoutMs) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  Slot *slot = findLocked(msgId);
+  if (!slot) {
+    xSemaphoreGive(mutex);
+    log_w("No publish tracked for msgId %u", msgId);
+    return false;
+  }
+  bool resolved = slot->state != SlotState::PENDING;
+  xSemaphoreGive(mutex);
+
+  if (!resolved) { xSemaphoreTake(slot->done, pdMS_TO_TICKS(timeoutMs)); }
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool delivered = false;
+  if (slot->msgId != msgId || slot->state == SlotState::FREE) {
+    log_w("Result of msgId %u was recycled before it was read", msgId);
+  } else if (slot->state == SlotState::PENDING) {
+    log_w("Timed out waiting for publish %u", msgId);
+    slot->state = SlotState::FREE;
+    pending--;
+    xSemaphoreGive(tokens);
+  } else {
+    delivered = slot->state == SlotState::DELIVERED;
+    slot->state = SlotState::FREE;
+  }
+  xSemaphoreGive(mutex);
+  return delivered;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+// Tracks QoS>0 publishes between AT+QMTPUBEX and their +QMTPUBEX: <cidx>,<msgid>,<result> URC.
+// At most window() messages are in flight; results stay readable until their slot is reused.
+class MqttPublishWindow {
+ public:
+  static constexpr uint8_t MAX_WINDOW = 16;
+  static constexpr uint8_t DEFAULT_WINDOW = 4;
+
+  MqttPublishWindow();
+  ~MqttPublishWindow();
+
+  // Only possible while nothing is in flight
+  bool setWindow(uint8_t size);
+  uint8_t window() const { return windowSize; }
+  uint8_t inFlight();
+
+  // Reserves a window slot and returns a msgId in 1..65535 not used by any tracked message,
+  // or -1 when no slot frees up within timeoutMs
+  int acquire(uint32_t timeoutMs);
+  // Gives the slot back without a result, for publishes the modem never accepted
+  void cancel(uint16_t msgId);
+  // Fed from the +QMTPUBEX URC: 0 delivered, 1 retransmitting, 2 failed
+  void complete(uint16_t msgId, int result);
+  // Fails every in-flight message, e.g. when the connection drops
+  void failAll();
+  // Blocks until msgId is acknowledged; true only if the broker confirmed it.
+  // On timeout the message is dropped from the window and its late URC is ignored.
+  bool wait(uint16_t msgId, uint32_t timeoutMs);
+
+ private:
+  enum class SlotState : uint8_t { FREE, PENDING, DELIVERED, FAILED };
+  struct Slot {
+    uint16_t msgId{0};
+    SlotState state{SlotState::FREE};
+    uint32_t seq{0};  // Order of completion, to recycle the oldest result first
+    SemaphoreHandle_t done{nullptr};
+  };
+
+  // Twice the window so results outlive the next window's worth of publishes
+  static constexpr uint8_t SLOT_COUNT = MAX_WINDOW * 2;
+
+  Slot slots[SLOT_COUNT];
+  SemaphoreHandle_t mutex;
+  SemaphoreHandle_t tokens;  // One per free window position
+  uint8_t windowSize{DEFAULT_WINDOW};
+  uint8_t pending{0};
+  uint16_t nextId{1};
+  uint32_t seqCounter{0};
+
+  Slot *findLocked(uint16_t msgId);
+  bool idInUseLocked(uint16_t msgId);
+  void finishLocked(Slot &slot, SlotState state);
+};
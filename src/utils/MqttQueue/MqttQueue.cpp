@@ -1,58 +1,142 @@
 #include "MqttQueue.h"
 
-#include <memory>
+#include <utility>
 
 #include "esp_log.h"
 
-AtomicMqttQueue::AtomicMqttQueue() {
-  messageQueue = xQueueCreate(10, sizeof(MqttMessage *));
-  if (messageQueue == NULL) { log_e("Failed to create message queue - CRITICAL"); }
+AtomicMqttQueue::AtomicMqttQueue(size_t capacity, MqttOverflowPolicy policy) {
+  configure(capacity, policy);
 }
 
 AtomicMqttQueue::~AtomicMqttQueue() {
-  if (messageQueue != NULL) {
-    MqttMessage *raw = nullptr;
-    while (xQueueReceive(messageQueue, &raw, 0) == pdTRUE) {
-      std::unique_ptr<MqttMessage> uptr(raw);
-    }
-    hasMessage.store(false);
-    vQueueDelete(messageQueue);
+  if (dataSignal) vSemaphoreDelete(dataSignal);
+}
+
+bool AtomicMqttQueue::configure(size_t capacity, MqttOverflowPolicy policy, size_t payloadReserve) {
+  if (capacity == 0) {
+    log_e("MQTT queue capacity must be at least 1");
+    return false;
   }
+  cells.reset(new Cell[capacity]);
+  slotCount = capacity;
+  overflowPolicy = policy;
+  for (size_t i = 0; i < capacity; ++i) {
+    cells[i].seq.store(i, std::memory_order_relaxed);
+    if (payloadReserve > 0) { cells[i].msg.payload.reserve(payloadReserve); }
+  }
+  enqueuePos.store(0, std::memory_order_relaxed);
+  dequeuePos.store(0, std::memory_order_relaxed);
+  return true;
 }
 
-bool AtomicMqttQueue::push(const MqttMessage &msg, TickType_t timeout) {
-  auto ptr = std::make_unique<MqttMessage>(msg);
-  MqttMessage *raw = ptr.get();
-  if (xQueueSend(messageQueue, &raw, timeout) == pdTRUE) {
-    auto a = ptr.release();
-    hasMessage.store(true);
-    return true;
+bool AtomicMqttQueue::tryPush(MqttMessage &msg) {
+  size_t pos = enqueuePos.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell &cell = cells[pos % slotCount];
+    size_t seq = cell.seq.load(std::memory_order_acquire);
+    intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+    if (dif == 0) {
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        std::swap(cell.msg, msg);
+        cell.seq.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (dif < 0) {
+      return false;  // Full
+    } else {
+      pos = enqueuePos.load(std::memory_order_relaxed);
+    }
   }
-  log_w("Message queue full, dropping MQTT message");
-  return false;
 }
 
-bool AtomicMqttQueue::pop(MqttMessage &msg) {
-  MqttMessage *raw = nullptr;
-  if (xQueueReceive(messageQueue, &raw, 0) == pdTRUE) {
-    std::unique_ptr<MqttMessage> uptr(raw);
-    msg = *uptr;
-    if (uxQueueMessagesWaiting(messageQueue) == 0) { hasMessage.store(false); }
-    return true;
+AtomicMqttQueue::Cell *AtomicMqttQueue::claimFront(size_t &pos) {
+  pos = dequeuePos.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell &cell = cells[pos % slotCount];
+    size_t seq = cell.seq.load(std::memory_order_acquire);
+    intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+    if (dif == 0) {
+      if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        return &cell;
+      }
+    } else if (dif < 0) {
+      return nullptr;  // Empty
+    } else {
+      pos = dequeuePos.load(std::memory_order_relaxed);
+    }
   }
-  return false;
 }
 
-bool AtomicMqttQueue::empty() { return !hasMessage.load(); }
+void AtomicMqttQueue::releaseFront(Cell &cell, size_t pos) {
+  cell.seq.store(pos + slotCount, std::memory_order_release);
+}
 
-size_t AtomicMqttQueue::size() { return uxQueueMessagesWaiting(messageQueue); }
+bool AtomicMqttQueue::tryPop(MqttMessage *out) {
+  size_t pos;
+  Cell *cell = claimFront(pos);
+  if (!cell) return false;
+  if (out) { std::swap(cell->msg, *out); }
+  releaseFront(*cell, pos);
+  return true;
+}
 
-void AtomicMqttQueue::clear() {
-  if (messageQueue != NULL) {
-    MqttMessage *raw = nullptr;
-    while (xQueueReceive(messageQueue, &raw, 0) == pdTRUE) {
-      std::unique_ptr<MqttMessage> uptr(raw);
+bool AtomicMqttQueue::push(MqttMessage &&msg, TickType_t timeout) {
+  const TickType_t start = xTaskGetTickCount();
+  bool evicted = false;
+  for (;;) {
+    if (tryPush(msg)) {
+      xSemaphoreGive(dataSignal);
+      return true;
+    }
+
+    switch (overflowPolicy) {
+      case MqttOverflowPolicy::DROP_OLDEST:
+        // Make room for this message once; if other producers refill the slot first, wait
+        // like BLOCK instead of evicting the whole queue
+        if (!evicted && tryPop(nullptr)) {
+          evicted = true;
+          droppedCount.fetch_add(1);
+          log_w("MQTT queue full, dropped oldest message");
+          continue;
+        }
+        if (xTaskGetTickCount() - start < timeout) {
+          vTaskDelay(1);
+          continue;
+        }
+        break;
+      case MqttOverflowPolicy::BLOCK:
+        if (xTaskGetTickCount() - start < timeout) {
+          vTaskDelay(1);
+          continue;
+        }
+        break;
+      case MqttOverflowPolicy::DROP_NEWEST:
+        break;
     }
+    droppedCount.fetch_add(1);
+    log_w("Message queue full, dropping MQTT message");
+    return false;
   }
-  hasMessage.store(false);
+}
+
+bool AtomicMqttQueue::pop(MqttMessage &msg) { return tryPop(&msg); }
+
+bool AtomicMqttQueue::waitForData(TickType_t timeout) {
+  if (!empty()) return true;
+  xSemaphoreTake(dataSignal, timeout);
+  return !empty();
+}
+
+void AtomicMqttQueue::wake() { xSemaphoreGive(dataSignal); }
+
+bool AtomicMqttQueue::empty() { return size() == 0; }
+
+size_t AtomicMqttQueue::size() {
+  size_t head = dequeuePos.load(std::memory_order_acquire);
+  size_t tail = enqueuePos.load(std::memory_order_acquire);
+  return tail > head ? tail - head : 0;
+}
+
+void AtomicMqttQueue::clear() {
+  while (tryPop(nullptr)) {}
 }
@@ -4,7 +4,7 @@
 
 #include <atomic>
 #include <memory>
-#include <queue>
+#include <vector>
 
 #include "freertos/FreeRTOS.h"
 
@@ -20,18 +20,73 @@ struct MqttMessage {
 
 using MqttMessagePtr = std::shared_ptr<MqttMessage>;
 
-class AtomicMqttQueue {
- private:
-  QueueHandle_t messageQueue;
-  std::atomic<bool> hasMessage{false};
+// What push() does when every slot is taken
+enum class MqttOverflowPolicy {
+  DROP_NEWEST,  // Reject the incoming message
+  DROP_OLDEST,  // Evict the oldest message once, then wait like BLOCK if still full
+  BLOCK,        // Wait up to the push timeout for a consumer, then reject
+};
 
+// Bounded lock-free MPMC ring of preallocated messages (Vyukov's sequence-per-cell scheme).
+// push() and pop() swap with the slot instead of copying, so payload buffers circulate between
+// the producer, the ring and the consumer and steady-state traffic does not touch the heap.
+class AtomicMqttQueue {
  public:
-  AtomicMqttQueue();
+  static constexpr size_t DEFAULT_CAPACITY = 10;
 
+  explicit AtomicMqttQueue(
+      size_t capacity = DEFAULT_CAPACITY,
+      MqttOverflowPolicy policy = MqttOverflowPolicy::BLOCK);
   ~AtomicMqttQueue();
-  bool push(const MqttMessage &msg, TickType_t timeout = 0);
+
+  // Reallocates the ring and reserves payloadReserve bytes in every slot. Not thread-safe:
+  // only call it while no producer or consumer is active.
+  bool configure(size_t capacity, MqttOverflowPolicy policy, size_t payloadReserve = 0);
+  size_t capacity() const { return slotCount; }
+  MqttOverflowPolicy policy() const { return overflowPolicy; }
+
+  // On success msg is left holding the slot's previous buffers for reuse
+  bool push(MqttMessage &&msg, TickType_t timeout = 0);
+  // The consumer's old buffers go back into the slot
   bool pop(MqttMessage &msg);
+  // Hands fn the oldest message in place and frees its slot once fn returns
+  template <typename F>
+  bool consume(F &&fn) {
+    size_t pos;
+    Cell *cell = claimFront(pos);
+    if (!cell) return false;
+    fn(cell->msg);
+    releaseFront(*cell, pos);
+    return true;
+  }
+  // Blocks until something is queued, wake() is called or timeout elapses
+  bool waitForData(TickType_t timeout);
+  void wake();
   bool empty();
   size_t size();
   void clear();
+
+  // Messages lost to the overflow policy since construction
+  uint32_t dropped() const { return droppedCount.load(); }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    MqttMessage msg;
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  size_t slotCount{0};
+  MqttOverflowPolicy overflowPolicy;
+  std::atomic<size_t> enqueuePos{0};
+  std::atomic<size_t> dequeuePos{0};
+  std::atomic<uint32_t> droppedCount{0};
+  SemaphoreHandle_t dataSignal = xSemaphoreCreateBinary();
+
+  bool tryPush(MqttMessage &msg);
+  // Swaps the oldest message into out; with out == nullptr it is discarded in place
+  bool tryPop(MqttMessage *out);
+  // Reserves the oldest filled cell for the caller, nullptr when empty
+  Cell *claimFront(size_t &pos);
+  void releaseFront(Cell &cell, size_t pos);
 };
@@ -0,0 +1,186 @@
+#include "MqttTopicRouter.h"
+
+#include <cstring>
+
+#include "esp_log.h"
+
+// Splits "<level>/<rest>" off the front of path; rest is empty with last set on the final level
+static std::string_view nextLevel(std::string_view &path, bool &last) {
+  size_t slash = path.find('/');
+  last = slash == std::string_view::npos;
+  std::string_view level = path.substr(0, slash);
+  path = last ? std::string_view() : path.substr(slash + 1);
+  return level;
+}
+
+MqttTopicRouter::MqttTopicRouter() { mutex = xSemaphoreCreateMutex(); }
+
+MqttTopicRouter::~MqttTopicRouter() {
+  if (mutex) vSemaphoreDelete(mutex);
+}
+
+bool MqttTopicRouter::isValidFilter(const char *filter) {
+  if (!filter || !*filter) return false;
+  std::string_view path(filter);
+  bool last = false;
+  while (!last) {
+    std::string_view level = nextLevel(path, last);
+    bool wildcard = level.find_first_of("+#") != std::string_view::npos;
+    if (wildcard && level.size() != 1) return false;
+    if (level == "#" && !last) return false;
+  }
+  return true;
+}
+
+bool MqttTopicRouter::add(const char *filter, MqttTopicHandler handler) {
+  if (!isValidFilter(filter) || !handler) {
+    log_e("Invalid MQTT topic filter '%s'", filter ? filter : "");
+    return false;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  Node *node = &root;
+  std::string_view path(filter);
+  bool last = false;
+  MqttTopicHandler *slot = nullptr;
+  while (!last) {
+    std::string_view level = nextLevel(path, last);
+    if (level == "#") {
+      slot = &node->hashHandler;
+      break;
+    }
+    std::unique_ptr<Node> *child;
+    if (level == "+") {
+      child = &node->plus;
+    } else {
+      auto it = node->children.find(level);
+      if (it == node->children.end()) {
+        it = node->children.emplace(std::string(level), nullptr).first;
+      }
+      child = &it->second;
+    }
+    if (!*child) child->reset(new Node());
+    node = child->get();
+  }
+  if (!slot) slot = &node->handler;
+  if (!*slot) filterCount++;
+  *slot = std::move(handler);
+  xSemaphoreGive(mutex);
+  return true;
+}
+
+bool MqttTopicRouter::removeFrom(Node &node, std::string_view rest, bool &removed) {
+  bool last = false;
+  std::string_view level = nextLevel(rest, last);
+  if (level == "#") {
+    removed = static_cast<bool>(node.hashHandler);
+    node.hashHandler = nullptr;
+    return node.empty();
+  }
+
+  std::unique_ptr<Node> *child = nullptr;
+  auto it = node.children.end();
+  if (level == "+") {
+    child = &node.plus;
+  } else {
+    it = node.children.find(level);
+    if (it != node.children.end()) child = &it->second;
+  }
+  if (!child || !*child) return false;
+
+  bool prune;
+  if (last) {
+    removed = static_cast<bool>((*child)->handler);
+    (*child)->handler = nullptr;
+    prune = (*child)->empty();
+  } else {
+    prune = removeFrom(**child, rest, removed);
+  }
+  // Drop branches that no longer lead to any filter
+  if (prune) {
+    if (it != node.children.end()) {
+      node.children.erase(it);
+    } else {
+      node.plus.reset();
+    }
+  }
+  return node.empty();
+}
+
+bool MqttTopicRouter::remove(const char *filter) {
+  if (!isValidFilter(filter)) return false;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool removed = false;
+  removeFrom(root, std::string_view(filter), removed);
+  if (removed) filterCount--;
+  xSemaphoreGive(mutex);
+  return removed;
+}
+
+MqttTopicRouter::Node *MqttTopicRouter::find(const char *filter) {
+  Node *node = &root;
+  std::string_view path(filter);
+  bool last = false;
+  while (node && !last) {
+    std::string_view level = nextLevel(path, last);
+    if (level == "#") return node->hashHandler ? node : nullptr;
+    if (level == "+") {
+      node = node->plus.get();
+    } else {
+      auto it = node->children.find(level);
+      node = it == node->children.end() ? nullptr : it->second.get();
+    }
+  }
+  return node && node->handler ? node : nullptr;
+}
+
+bool MqttTopicRouter::contains(const char *filter) {
+  if (!isValidFilter(filter)) return false;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool found = find(filter) != nullptr;
+  xSemaphoreGive(mutex);
+  return found;
+}
+
+size_t MqttTopicRouter::size() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  size_t count = filterCount;
+  xSemaphoreGive(mutex);
+  return count;
+}
+
+void MqttTopicRouter::match(
+    Node &node, const char *level, bool systemTopic, char *topic, uint8_t *payload,
+    unsigned int length, size_t &count) {
+  // "a/#" covers "a" itself and everything below it. Wildcards in the first level never match
+  // topics starting with '$'.
+  if (node.hashHandler && !systemTopic) {
+    node.hashHandler(topic, payload, length);
+    count++;
+  }
+  if (!level) {
+    if (node.handler) {
+      node.handler(topic, payload, length);
+      count++;
+    }
+    return;
+  }
+
+  const char *slash = strchr(level, '/');
+  size_t len = slash ? static_cast<size_t>(slash - level) : strlen(level);
+  const char *next = slash ? slash + 1 : nullptr;
+
+  auto it = node.children.find(std::string_view(level, len));
+  if (it != node.children.end()) {
+    match(*it->second, next, false, topic, payload, length, count);
+  }
+  if (node.plus && !systemTopic) { match(*node.plus, next, false, topic, payload, length, count); }
+}
+
+size_t MqttTopicRouter::dispatch(char *topic, uint8_t *payload, unsigned int length) {
+  if (!topic) return 0;
+  size_t count = 0;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  match(root, topic, topic[0] == '$', topic, payload, length, count);
+  xSemaphoreGive(mutex);
+  return count;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "freertos/FreeRTOS.h"
+
+using MqttTopicHandler = std::function<void(char *, uint8_t *, unsigned int)>;
+
+// Maps MQTT topic filters, including '+' and '#' wildcards, to handlers. Filters are stored as a
+// trie of topic levels, so matching a topic costs one lookup per level no matter how many
+// filters are registered.
+class MqttTopicRouter {
+ public:
+  MqttTopicRouter();
+  ~MqttTopicRouter();
+
+  // '#' must be the last level and '+'/'#' must fill their whole level
+  static bool isValidFilter(const char *filter);
+
+  // Replaces the handler of an already registered filter
+  bool add(const char *filter, MqttTopicHandler handler);
+  bool remove(const char *filter);
+  bool contains(const char *filter);
+  size_t size();
+
+  // Runs every handler whose filter matches topic and returns how many ran. Handlers are called
+  // with the router locked, so they must not add or remove filters themselves.
+  size_t dispatch(char *topic, uint8_t *payload, unsigned int length);
+
+ private:
+  struct Node {
+    std::map<std::string, std::unique_ptr<Node>, std::less<>> children;
+    std::unique_ptr<Node> plus;    // '+' level
+    MqttTopicHandler handler;      // Filter ending at this node
+    MqttTopicHandler hashHandler;  // Filter ending in '#' below this node
+
+    bool empty() const { return children.empty() && !plus && !handler && !hashHandler; }
+  };
+
+  Node root;
+  size_t filterCount{0};
+  SemaphoreHandle_t mutex;
+
+  Node *find(const char *filter);
+  static bool removeFrom(Node &node, std::string_view rest, bool &removed);
+  static void match(
+      Node &node, const char *level, bool systemTopic, char *topic, uint8_t *payload,
+      unsigned int length, size_t &count);
+};
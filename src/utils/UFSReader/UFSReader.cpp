@@ -0,0 +1,118 @@
+#include "UFSReader.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "esp_log.h"
+
+UFSReader::UFSReader(UFSFileRequester &fileRequester, size_t blockSize)
+    : requester(&fileRequester) {
+  block.resize(std::min(std::max(blockSize, MIN_BLOCK_SIZE), MAX_READ_SIZE));
+}
+
+UFSReader::~UFSReader() { close(); }
+
+bool UFSReader::open(const char *name) {
+  close();
+  size_t length = 0;
+  int h = requester->openFile(name, length);
+  if (h < 0) {
+    log_e("Failed to open UFS file %s", name ? name : "");
+    return false;
+  }
+  handle = h;
+  fileSize = length;
+  pos = 0;
+  blockPos = blockLen = 0;
+  return true;
+}
+
+void UFSReader::close() {
+  if (handle < 0) return;
+  requester->closeFile(handle);
+  handle = -1;
+  fileSize = 0;
+  pos = 0;
+  blockPos = blockLen = 0;
+}
+
+bool UFSReader::seek(size_t offset) {
+  if (handle < 0 || offset > fileSize) return false;
+  // Still inside the buffered block: no round trip
+  size_t blockStart = pos - blockPos;
+  if (offset >= blockStart && offset < blockStart + blockLen) {
+    blockPos = offset - blockStart;
+    pos = offset;
+    return true;
+  }
+  if (!requester->seekFile(handle, offset)) {
+    log_e("Failed to seek UFS file to %u", static_cast<unsigned>(offset));
+    return false;
+  }
+  pos = offset;
+  blockPos = blockLen = 0;
+  return true;
+}
+
+int UFSReader::available() {
+  if (handle < 0) return 0;
+  return static_cast<int>(std::min(fileSize - pos, static_cast<size_t>(INT_MAX)));
+}
+
+int UFSReader::fetch(uint8_t *buf, size_t len) {
+  int got = requester->readFile(handle, buf, std::min(len, MAX_READ_SIZE));
+  if (got < 0) log_e("AT+QFREAD failed at offset %u", static_cast<unsigned>(pos));
+  return got;
+}
+
+bool UFSReader::fill() {
+  if (blockPos < blockLen) return true;
+  if (handle < 0 || pos >= fileSize) return false;
+  int got = fetch(block.data(), std::min(block.size(), fileSize - pos));
+  blockPos = 0;
+  blockLen = got > 0 ? static_cast<size_t>(got) : 0;
+  return blockLen > 0;
+}
+
+int UFSReader::read() {
+  if (!fill()) return -1;
+  pos++;
+  return block[blockPos++];
+}
+
+int UFSReader::peek() {
+  if (!fill()) return -1;
+  return block[blockPos];
+}
+
+size_t UFSReader::read(uint8_t *buf, size_t size) {
+  if (!buf || handle < 0) return 0;
+  size = std::min(size, fileSize - pos);
+  size_t copied = 0;
+  while (copied < size) {
+    // Buffered bytes first
+    if (blockPos < blockLen) {
+      size_t n = std::min(blockLen - blockPos, size - copied);
+      memcpy(buf + copied, block.data() + blockPos, n);
+      blockPos += n;
+      pos += n;
+      copied += n;
+      continue;
+    }
+    // Whole blocks skip the buffer
+    if (size - copied >= block.size()) {
+      int got = fetch(buf + copied, size - copied);
+      if (got <= 0) break;
+      pos += got;
+      copied += got;
+      continue;
+    }
+    if (!fill()) break;
+  }
+  return copied;
+}
+
+size_t UFSReader::readBytes(char *buffer, size_t length) {
+  return read(reinterpret_cast<uint8_t *>(buffer), length);
+}
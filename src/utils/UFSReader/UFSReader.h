@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Stream.h>
+
+#include <vector>
+
+// File operations a UFSReader needs. The modem driver implements them with AT+QFOPEN, AT+QFREAD,
+// AT+QFSEEK and AT+QFCLOSE.
+class UFSFileRequester {
+ public:
+  virtual ~UFSFileRequester() {}
+  // Opens name read-only and returns its handle, or -1; size receives the file length
+  virtual int openFile(const char *name, size_t &size) = 0;
+  // Reads up to len bytes into buf and returns how many, 0 at the end of the file or -1 on error
+  virtual int readFile(int handle, uint8_t *buf, size_t len) = 0;
+  virtual bool seekFile(int handle, size_t offset) = 0;
+  virtual bool closeFile(int handle) = 0;
+};
+
+// Reads a file from the modem's UFS as a Stream. Small reads are served from a block fetched
+// with one AT+QFREAD; read(buf, size) of at least a block goes straight into buf.
+class UFSReader : public Stream {
+ public:
+  explicit UFSReader(UFSFileRequester &requester, size_t blockSize = DEFAULT_BLOCK_SIZE);
+  ~UFSReader();
+
+  bool open(const char *name);
+  void close();
+  bool isOpen() const { return handle >= 0; }
+  size_t size() const { return fileSize; }
+  size_t position() const { return pos; }
+  bool seek(size_t offset);
+
+  // Bytes left in the file
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t *buf, size_t size);
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) { return read(buffer, length); }
+  // Read-only
+  size_t write(uint8_t) override { return 0; }
+  void flush() override {}
+
+  static constexpr size_t MIN_BLOCK_SIZE = 64;
+  static constexpr size_t DEFAULT_BLOCK_SIZE = 1024;
+  // Largest AT+QFREAD issued, so one reply stays well within the driver's payload timeout
+  static constexpr size_t MAX_READ_SIZE = 4096;
+
+ private:
+  UFSFileRequester *requester;
+  std::vector<uint8_t> block;
+  size_t blockPos{0};
+  size_t blockLen{0};
+  int handle{-1};
+  size_t fileSize{0};
+  size_t pos{0};  // Offset of the next byte handed out
+
+  bool fill();
+  // One read of at most MAX_READ_SIZE bytes
+  int fetch(uint8_t *buf, size_t len);
+};
@@ -0,0 +1,51 @@
+// Heap allocation counters for native benchmarks.
+// This header replaces the global operator new/delete, so include it from exactly one
+// translation unit per test executable.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+inline std::atomic<size_t> gAllocCount{0};
+inline std::atomic<size_t> gAllocBytes{0};
+
+struct AllocSnapshot {
+  size_t count;
+  size_t bytes;
+};
+
+inline AllocSnapshot allocSnapshot() { return {gAllocCount.load(), gAllocBytes.load()}; }
+
+inline AllocSnapshot allocSince(const AllocSnapshot &start) {
+  AllocSnapshot now = allocSnapshot();
+  return {now.count - start.count, now.bytes - start.bytes};
+}
+
+void *operator new(std::size_t size) {
+  gAllocCount.fetch_add(1, std::memory_order_relaxed);
+  gAllocBytes.fetch_add(size, std::memory_order_relaxed);
+  void *p = std::malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](std::size_t size) { return ::operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return ::operator new(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
@@ -6,7 +6,10 @@
 
 #include <atomic>
 #include <cstdio>
+#include <map>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include "common.h"
 
@@ -24,6 +27,18 @@ using ::testing::NiceMock;
   do { (void)sizeof(strref); } while (0)
 #endif
 
+// Benchmark figures are only printed alongside the serial trace
+#if LOG_LEVEL == 5
+#define BENCH_LOG(...)   \
+  do {                   \
+    printf(__VA_ARGS__); \
+    fflush(stdout);      \
+  } while (0)
+#else
+#define BENCH_LOG(...) \
+  do { if (0) printf(__VA_ARGS__); } while (0)
+#endif
+
 inline void InjectRx(class MockStream *s, const std::string &data) {
   SERIAL_LOG("RX >", data);
   s->InjectRxData(data);
@@ -158,6 +173,8 @@ inline void startTcpResponderCapturing(
           continue;
         }
 
+        // Tests inject the +QIRD reply themselves, OK included
+        if (starts_with("AT+QIRD=")) continue;
         // Generic OK for other AT+ commands to avoid swallowing them
         if (starts_with("AT+")) {
           InjectRx(s, "OK\r\n");
@@ -192,3 +209,149 @@ inline void startTcpResponderCapturing(
     vTaskDelay(pdMS_TO_TICKS(1));
   }
 }
+
+// UFS side of AT+QFLST, AT+QFUPL, AT+QFDEL and the AT+QFOPEN family; other AT commands are
+// acknowledged and recorded
+struct UfsModem {
+  std::map<std::string, std::string> files;
+  std::vector<std::string> commands;  // Everything but the uploaded bytes
+  bool corruptChecksum{false};        // Report a +QFUPL checksum that does not match
+  const char *checksumFormat{"%x"};   // How the +QFUPL checksum is printed
+  std::map<int, std::pair<std::string, size_t>> handles;  // Open file and its offset
+  std::vector<size_t> reads;                              // Length of each AT+QFREAD
+};
+
+// XOR of big-endian 16-bit words, as the modem reports in +QFUPL
+inline uint16_t UfsChecksum(const std::string &data) {
+  uint16_t sum = 0;
+  for (size_t i = 0; i < data.size(); i++) {
+    uint8_t b = static_cast<uint8_t>(data[i]);
+    sum ^= (i & 1) ? b : static_cast<uint16_t>(b << 8);
+  }
+  return sum;
+}
+
+inline size_t countPrefix(const std::vector<std::string> &commands, const std::string &prefix) {
+  size_t n = 0;
+  for (const auto &cmd : commands) n += cmd.rfind(prefix, 0) == 0;
+  return n;
+}
+
+inline bool sent(const std::vector<std::string> &commands, const std::string &cmd) {
+  for (const auto &c : commands) {
+    if (c == cmd) return true;
+  }
+  return false;
+}
+
+inline void startUfsResponder(NiceMock<MockStream> *s, std::atomic<bool> *done, UfsModem *ufs) {
+  auto responder = [](void *pv) {
+    using Ctx = std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, UfsModem *>;
+    auto *ctx = static_cast<Ctx *>(pv);
+    auto *s = std::get<0>(*ctx);
+    auto *done = std::get<1>(*ctx);
+    auto *ufs = std::get<2>(*ctx);
+
+    std::string acc;
+    std::string uploadName;
+    size_t uploadLeft = 0;
+    TickType_t start = xTaskGetTickCount();
+    const TickType_t maxTicks = pdMS_TO_TICKS(10000);
+    while (!done->load()) {
+      if ((xTaskGetTickCount() - start) > maxTicks) break;
+
+      std::string chunk = DrainTx(s);
+      if (!chunk.empty()) acc += chunk;
+
+      // Raw file bytes after CONNECT
+      if (uploadLeft > 0) {
+        size_t n = std::min(uploadLeft, acc.size());
+        ufs->files[uploadName] += acc.substr(0, n);
+        acc.erase(0, n);
+        uploadLeft -= n;
+        if (uploadLeft == 0) {
+          const std::string &file = ufs->files[uploadName];
+          char checksum[16];
+          snprintf(
+              checksum, sizeof(checksum), ufs->checksumFormat,
+              static_cast<unsigned>(UfsChecksum(file) ^ (ufs->corruptChecksum ? 1 : 0)));
+          InjectRx(
+              s, "+QFUPL: " + std::to_string(file.size()) + "," + checksum + "\r\nOK\r\n");
+        }
+      }
+
+      size_t pos;
+      while (uploadLeft == 0 && (pos = acc.find("\r\n")) != std::string::npos) {
+        std::string cmd = acc.substr(0, pos);
+        acc.erase(0, pos + 2);
+        if (cmd.empty()) continue;
+        ufs->commands.push_back(cmd);
+        auto starts_with = [&](const char *p) { return cmd.rfind(p, 0) == 0; };
+        size_t q1 = cmd.find('"');
+        size_t q2 = cmd.find('"', q1 + 1);
+        std::string name = q1 == std::string::npos ? "" : cmd.substr(q1 + 1, q2 - q1 - 1);
+
+        if (starts_with("AT+QFLST=")) {
+          std::string resp;
+          for (const auto &file : ufs->files) {
+            if (name != "*" && name != file.first) continue;
+            resp += "+QFLST: \"" + file.first + "\"," + std::to_string(file.second.size()) + "\r\n";
+          }
+          InjectRx(s, resp + "OK\r\n");
+          continue;
+        }
+        if (starts_with("AT+QFUPL=")) {
+          uploadName = name;
+          uploadLeft = std::stoul(cmd.substr(q2 + 2));
+          ufs->files[uploadName].clear();
+          InjectRx(s, "CONNECT\r\n");
+          break;
+        }
+        if (starts_with("AT+QFDEL=")) {
+          InjectRx(s, ufs->files.erase(name) ? "OK\r\n" : "+CME ERROR: 405\r\n");
+          continue;
+        }
+        if (starts_with("AT+QFOPEN=")) {
+          int handle = 1024 + static_cast<int>(ufs->handles.size());
+          ufs->handles[handle] = {name, 0};
+          InjectRx(s, "+QFOPEN: " + std::to_string(handle) + "\r\nOK\r\n");
+          continue;
+        }
+        if (starts_with("AT+QFREAD=") || starts_with("AT+QFSEEK=")) {
+          // AT+QFREAD=<handle>,<len> / AT+QFSEEK=<handle>,<offset>,0
+          size_t comma = cmd.find(',');
+          auto it = ufs->handles.find(std::stoi(cmd.substr(10, comma - 10)));
+          if (it == ufs->handles.end()) {
+            InjectRx(s, "+CME ERROR: 420\r\n");
+            continue;
+          }
+          size_t arg = std::stoul(cmd.substr(comma + 1));
+          if (starts_with("AT+QFSEEK=")) {
+            it->second.second = arg;
+            InjectRx(s, "OK\r\n");
+            continue;
+          }
+          ufs->reads.push_back(arg);
+          const std::string &file = ufs->files[it->second.first];
+          std::string data = file.substr(std::min(it->second.second, file.size()), arg);
+          it->second.second += data.size();
+          InjectRx(s, "\r\nCONNECT " + std::to_string(data.size()) + "\r\n" + data + "\r\nOK\r\n");
+          continue;
+        }
+        if (starts_with("AT+QFCLOSE=")) {
+          ufs->handles.erase(std::stoi(cmd.substr(11)));
+          InjectRx(s, "OK\r\n");
+          continue;
+        }
+        if (starts_with("AT")) InjectRx(s, "OK\r\n");
+      }
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    delete ctx;
+    vTaskDelete(nullptr);
+  };
+  auto *ctx =
+      new std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, UfsModem *>(s, done, ufs);
+  xTaskCreate(responder, "UFS_RESP", configMINIMAL_STACK_SIZE * 4, ctx, 3, nullptr);
+  vTaskDelay(pdMS_TO_TICKS(5));
+}
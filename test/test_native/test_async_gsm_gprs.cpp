@@ -135,7 +135,8 @@ static void startNoSimResponder(NiceMock<MockStream> *s, std::atomic<bool> *done
           continue;
         }
         if (starts_with("AT+CGMM")) {
-          InjectRx(s, "\r\nEG915U\r\n\r\nOK\r\n");
+          // Chained AT+CGMM;+CGMI answers both in one reply
+          InjectRx(s, "\r\nEG915U\r\n\r\nQuectel\r\n\r\nOK\r\n");
           continue;
         }
         if (starts_with("AT+CGMI")) {
@@ -167,6 +168,192 @@ static void startNoSimResponder(NiceMock<MockStream> *s, std::atomic<bool> *done
   }
 }
 
+// Full bring-up where the SIM and the network only become ready later and announce it by URC
+static void startColdBootResponder(NiceMock<MockStream> *s, std::atomic<bool> *done) {
+  auto responder = [](void *pv) {
+    using Ctx = std::tuple<NiceMock<MockStream> *, std::atomic<bool> *>;
+    auto *ctx = static_cast<Ctx *>(pv);
+    auto *s = std::get<0>(*ctx);
+    auto *done = std::get<1>(*ctx);
+
+    std::string acc;
+    bool simReady = false;
+    bool registered = false;
+    TickType_t simAsked = 0;
+    TickType_t regAsked = 0;
+    TickType_t t0 = xTaskGetTickCount();
+    while (!done->load()) {
+      if ((xTaskGetTickCount() - t0) > pdMS_TO_TICKS(15000)) break;
+      TickType_t now = xTaskGetTickCount();
+      if (!simReady && simAsked && (now - simAsked) > pdMS_TO_TICKS(300)) {
+        simReady = true;
+        InjectRx(s, "\r\n+CPIN: READY\r\n");
+      }
+      if (!registered && regAsked && (now - regAsked) > pdMS_TO_TICKS(300)) {
+        registered = true;
+        InjectRx(s, "\r\n+CREG: 1\r\n");
+      }
+
+      std::string chunk = DrainTx(s);
+      if (!chunk.empty()) acc += chunk;
+      size_t pos;
+      while ((pos = acc.find("\r\n")) != std::string::npos) {
+        std::string cmd = acc.substr(0, pos);
+        acc.erase(0, pos + 2);
+        auto starts_with = [&](const char *p) { return cmd.rfind(p, 0) == 0; };
+        if (starts_with("AT+CGMM")) {
+          InjectRx(s, "\r\nEG915U\r\n\r\nQuectel\r\n\r\nOK\r\n");
+        } else if (cmd == "AT+CPIN?") {
+          if (!simAsked) simAsked = xTaskGetTickCount();
+          InjectRx(
+              s, simReady ? "\r\n+CPIN: READY\r\n\r\nOK\r\n"
+                          : "\r\n+CPIN: NOT READY\r\n\r\nOK\r\n");
+        } else if (cmd == "AT+CREG?") {
+          if (!regAsked) regAsked = xTaskGetTickCount();
+          InjectRx(
+              s, registered ? "\r\n+CREG: 1,1\r\n\r\nOK\r\n" : "\r\n+CREG: 1,2\r\n\r\nOK\r\n");
+        } else if (cmd == "AT+CGATT?") {
+          InjectRx(s, "\r\n+CGATT: 1\r\n\r\nOK\r\n");
+        } else if (cmd == "AT+QIACT?") {
+          InjectRx(s, "\r\n+QIACT: 1,1,1,\"10.0.0.2\"\r\n\r\nOK\r\n");
+        } else if (starts_with("AT")) {
+          InjectRx(s, "OK\r\n");
+        }
+      }
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    delete ctx;
+    vTaskDelete(nullptr);
+  };
+  auto *ctx = new std::tuple<NiceMock<MockStream> *, std::atomic<bool> *>(s, done);
+  xTaskCreate(responder, "COLD_BOOT", configMINIMAL_STACK_SIZE * 4, ctx, 3, nullptr);
+  vTaskDelay(pdMS_TO_TICKS(5));
+}
+
+TEST_F(AsyncGSMGprsTest, SetupNetwork_WakesOnUrcsAndReportsTiming) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mockStream));
+
+        std::atomic<bool> done{false};
+        startColdBootResponder(mockStream, &done);
+
+        EXPECT_TRUE(gsm->context().setupNetwork("internet"));
+        const GSMBringUpTiming &t = gsm->context().bringUpTiming();
+        // Both waits end on the URC (~300 ms) rather than on a poll interval
+        EXPECT_GE(t.simMs, 250u);
+        EXPECT_LT(t.simMs, 1500u);
+        EXPECT_LT(t.registrationMs, 1500u);
+        EXPECT_GE(t.totalMs, t.probeMs + t.configMs + t.simMs + t.registrationMs);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "SetupNetColdBoot", 8192, 2, 20000);
+  EXPECT_TRUE(ok);
+}
+
+// Modem that kept its state across an MCU reset; records every command it receives
+struct WarmModemState {
+  bool pdpActive{true};
+  std::string sent;
+};
+
+static void startWarmResponder(
+    NiceMock<MockStream> *s, std::atomic<bool> *done, WarmModemState *state) {
+  auto responder = [](void *pv) {
+    using Ctx = std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, WarmModemState *>;
+    auto *ctx = static_cast<Ctx *>(pv);
+    auto *s = std::get<0>(*ctx);
+    auto *done = std::get<1>(*ctx);
+    auto *state = std::get<2>(*ctx);
+
+    std::string acc;
+    TickType_t t0 = xTaskGetTickCount();
+    while (!done->load()) {
+      if ((xTaskGetTickCount() - t0) > pdMS_TO_TICKS(10000)) break;
+      std::string chunk = DrainTx(s);
+      if (!chunk.empty()) acc += chunk;
+      size_t pos;
+      while ((pos = acc.find("\r\n")) != std::string::npos) {
+        std::string cmd = acc.substr(0, pos);
+        acc.erase(0, pos + 2);
+        state->sent += cmd + "\n";
+        if (cmd.rfind("AT+CPIN?;", 0) == 0) {
+          std::string reply =
+              "\r\n+CPIN: READY\r\n\r\n+QDSIM: 0\r\n\r\n+CREG: 1,1\r\n"
+              "\r\n+QICSGP: 1,\"internet\",\"\",\"\",1\r\n";
+          if (state->pdpActive) reply += "\r\n+QIACT: 1,1,1,\"10.0.0.2\"\r\n";
+          reply += "\r\n+QISTATE: 2,\"TCP\",\"1.2.3.4\",80,0,2,1,2,0,\"uart1\"\r\n";
+          reply += "\r\n+QSSLSTATE: 4,\"SSLClient\",\"1.2.3.4\",443,0,2,1,4,0,\"uart1\",1\r\n";
+          reply += "\r\nOK\r\n";
+          InjectRx(s, reply);
+        } else if (cmd == "AT+CGATT?") {
+          InjectRx(s, "\r\n+CGATT: 1\r\n\r\nOK\r\n");
+        } else if (cmd == "AT+QIACT?") {
+          InjectRx(s, "\r\n+QIACT: 1,1,1,\"10.0.0.2\"\r\n\r\nOK\r\n");
+        } else if (cmd.rfind("AT", 0) == 0) {
+          InjectRx(s, "OK\r\n");
+        }
+      }
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    delete ctx;
+    vTaskDelete(nullptr);
+  };
+  auto *ctx = new std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, WarmModemState *>(
+      s, done, state);
+  xTaskCreate(responder, "WARM_RESP", configMINIMAL_STACK_SIZE * 4, ctx, 3, nullptr);
+  vTaskDelay(pdMS_TO_TICKS(5));
+}
+
+TEST_F(AsyncGSMGprsTest, WarmStart_ReusesActivePdpContext) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mockStream));
+
+        std::atomic<bool> done{false};
+        WarmModemState state;
+        startWarmResponder(mockStream, &done, &state);
+
+        EXPECT_TRUE(gsm->context().setupNetwork("internet", GSMStartMode::WARM));
+        EXPECT_LT(gsm->context().bringUpTiming().totalMs, 1000u);
+
+        // Only the probe, the combined query and the close of the stale TCP and SSL sockets
+        EXPECT_EQ(
+            state.sent,
+            "AT\nAT+CPIN?;+QDSIM?;+CREG?;+QICSGP=1;+QIACT?;+QISTATE?;+QSSLSTATE?\n"
+            "AT+QICLOSE=2\nAT+QSSLCLOSE=4\n");
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "WarmStartReuse", 8192, 2, 10000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(AsyncGSMGprsTest, WarmStart_ActivatesPdpWithoutReconfiguring) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mockStream));
+
+        std::atomic<bool> done{false};
+        WarmModemState state;
+        state.pdpActive = false;
+        startWarmResponder(mockStream, &done, &state);
+
+        EXPECT_TRUE(gsm->context().setupNetwork("internet", GSMStartMode::WARM));
+        EXPECT_EQ(state.sent.find("ATE0"), std::string::npos);
+        EXPECT_EQ(state.sent.find("AT+CPIN?\n"), std::string::npos);
+        EXPECT_NE(state.sent.find("AT+QIACT=1\n"), std::string::npos);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "WarmStartActivate", 8192, 2, 10000);
+  EXPECT_TRUE(ok);
+}
+
 TEST_F(AsyncGSMGprsTest, GprsConnect_Succeeds_WithAPNUserPwd) {
   bool ok = runInFreeRTOSTask(
       [this]() {
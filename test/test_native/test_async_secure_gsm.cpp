@@ -3,6 +3,7 @@
 
 #include <atomic>
 #include <string>
+#include <vector>
 
 #include "common/common.h"
 #include "common/responder.h"
@@ -165,4 +166,110 @@ TEST_F(AsyncSecureGsmTest, SetCACertUploadsOnceAndCaches) {
   EXPECT_TRUE(ok);
 }
 
+TEST_F(AsyncSecureGsmTest, SslConfigIsOnlyResentAfterModemRestart) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mock));
+        std::atomic<bool> done{false};
+        std::string captured;
+        startSslResponderCapturing(mock, &done, &captured);
+
+        auto sslConfigCommands = [&]() {
+          size_t n = 0;
+          for (size_t p = captured.find("AT+QSSLCFG="); p != std::string::npos;
+               p = captured.find("AT+QSSLCFG=", p + 1)) {
+            n++;
+          }
+          return n;
+        };
+        AsyncEG915U &modem = gsm->context().modem();
+
+        EXPECT_TRUE(modem.connectSecure("example.com", 443, 0));
+        EXPECT_EQ(sslConfigCommands(), 5u);
+
+        // Same settings: straight to AT+QSSLOPEN
+        EXPECT_TRUE(modem.connectSecure("example.com", 443, 0));
+        EXPECT_EQ(sslConfigCommands(), 5u);
+
+        // A restarted modem is back to defaults, so everything goes out again
+        modem.URCState.simReady.store(true);
+        InjectRx(mock, "\r\nRDY\r\n");
+        vTaskDelay(pdMS_TO_TICKS(20));
+        EXPECT_FALSE(modem.URCState.simReady.load());
+        EXPECT_TRUE(modem.connectSecure("example.com", 443, 0));
+        EXPECT_EQ(sslConfigCommands(), 10u);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(30));
+      },
+      "SslConfigCache", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
+// AT+QSSLCFG lines in the order they were sent
+static std::vector<std::string> sslConfigLines(const std::string &captured) {
+  std::vector<std::string> lines;
+  size_t start = 0;
+  size_t end;
+  while ((end = captured.find("\r\n", start)) != std::string::npos) {
+    std::string line = captured.substr(start, end - start);
+    if (line.rfind("AT+QSSLCFG=", 0) == 0) lines.push_back(line);
+    start = end + 2;
+  }
+  return lines;
+}
+
+TEST_F(AsyncSecureGsmTest, SslProfilesSendTheirExactConfig) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mock));
+        std::atomic<bool> done{false};
+        std::string captured;
+        startSslResponderCapturing(mock, &done, &captured);
+        AsyncEG915U &modem = gsm->context().modem();
+        auto connectWith = [&](const EG915SslOptions &options) {
+          gsm->setSslOptions(options);
+          EXPECT_TRUE(modem.connectSecure("example.com", 443, 0));
+          vTaskDelay(pdMS_TO_TICKS(20));
+          std::vector<std::string> lines = sslConfigLines(captured);
+          captured.clear();
+          return lines;
+        };
+
+        std::vector<std::string> compatible = {
+            "AT+QSSLCFG=\"sslversion\",1,3", "AT+QSSLCFG=\"ciphersuite\",1,0X0035",
+            "AT+QSSLCFG=\"sni\",1,1",        "AT+QSSLCFG=\"session\",1,0",
+            "AT+QSSLCFG=\"seclevel\",1,0",
+        };
+        EXPECT_EQ(connectWith(EG915SslOptions::compatible()), compatible);
+
+        // Switching profiles only sends what differs
+        std::vector<std::string> fast = {
+            "AT+QSSLCFG=\"ciphersuite\",1,0XFFFF",
+            "AT+QSSLCFG=\"session\",1,1",
+        };
+        EXPECT_EQ(connectWith(EG915SslOptions::fast()), fast);
+
+        EG915SslOptions custom;
+        custom.version = EG915TlsVersion::ALL;
+        custom.cipherSuite = EG915_CIPHER_ECDHE_RSA_AES_128_GCM_SHA256;
+        custom.sni = false;
+        custom.sessionResumption = true;
+        std::vector<std::string> customLines = {
+            "AT+QSSLCFG=\"sslversion\",1,4",
+            "AT+QSSLCFG=\"ciphersuite\",1,0XC02F",
+            "AT+QSSLCFG=\"sni\",1,0",
+        };
+        EXPECT_EQ(connectWith(custom), customLines);
+
+        // Reconnecting with the same profile goes straight to AT+QSSLOPEN
+        EXPECT_TRUE(connectWith(custom).empty());
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(30));
+      },
+      "SslProfiles", 8192, 3, 10000);
+  EXPECT_TRUE(ok);
+}
+
 FREERTOS_TEST_MAIN()
@@ -0,0 +1,167 @@
+#include <AsyncGSM.h>
+
+#include <atomic>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "common/common.h"
+#include "common/responder.h"
+
+using ::testing::NiceMock;
+
+struct SendCapture {
+  std::vector<size_t> segments;  // Lengths announced in each AT+QISEND
+  std::string payload;           // Raw bytes written after each '>' prompt
+  int rejectSegment{-1};         // Index of the AT+QISEND answered with ERROR, -1 for none
+};
+
+// Consumes exactly the announced number of payload bytes after each prompt so the
+// segmentation seen on the wire can be checked
+static void startSegmentingResponder(
+    NiceMock<MockStream> *s, std::atomic<bool> *done, SendCapture *cap) {
+  auto responder = [](void *pv) {
+    using Ctx = std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, SendCapture *>;
+    auto *ctx = static_cast<Ctx *>(pv);
+    auto *s = std::get<0>(*ctx);
+    auto *done = std::get<1>(*ctx);
+    auto *cap = std::get<2>(*ctx);
+
+    std::string acc;
+    size_t pending = 0;
+    TickType_t start = xTaskGetTickCount();
+    const TickType_t maxTicks = pdMS_TO_TICKS(10000);
+    while (!done->load()) {
+      if ((xTaskGetTickCount() - start) > maxTicks) break;
+
+      std::string chunk = s->GetTxData();
+      if (!chunk.empty()) acc += chunk;
+
+      bool progressed = true;
+      while (progressed) {
+        progressed = false;
+        if (pending > 0) {
+          if (acc.size() < pending) break;
+          cap->payload += acc.substr(0, pending);
+          acc.erase(0, pending);
+          pending = 0;
+          InjectRx(s, "\r\nSEND OK\r\n");
+          progressed = true;
+          continue;
+        }
+
+        size_t pos = acc.find("\r\n");
+        if (pos == std::string::npos) break;
+        std::string cmd = acc.substr(0, pos);
+        acc.erase(0, pos + 2);
+        progressed = true;
+
+        if (cmd.rfind("AT+QIOPEN", 0) == 0) {
+          InjectRx(s, "OK\r\n");
+          InjectRx(s, "+QIOPEN: 0,0\r\n");
+          continue;
+        }
+        if (cmd.rfind("AT+QISEND=0,", 0) == 0) {
+          int index = static_cast<int>(cap->segments.size());
+          cap->segments.push_back(std::stoul(cmd.substr(12)));
+          if (index == cap->rejectSegment) {
+            InjectRx(s, "\r\nERROR\r\n");
+            continue;
+          }
+          pending = cap->segments.back();
+          InjectRx(s, ">\r\n");
+          continue;
+        }
+        if (cmd.rfind("AT+", 0) == 0) { InjectRx(s, "OK\r\n"); }
+      }
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    delete ctx;
+    vTaskDelete(nullptr);
+  };
+  auto *ctx =
+      new std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, SendCapture *>(s, done, cap);
+  xTaskCreate(responder, "SEG_RESP", configMINIMAL_STACK_SIZE * 4, ctx, 3, nullptr);
+  vTaskDelay(pdMS_TO_TICKS(5));
+}
+
+static std::vector<uint8_t> makeBody(size_t len) {
+  std::vector<uint8_t> body(len);
+  for (size_t i = 0; i < len; ++i) { body[i] = static_cast<uint8_t>('a' + (i % 26)); }
+  return body;
+}
+
+class ChunkedSendTest : public FreeRTOSTest {
+ protected:
+  AsyncGSM *gsm{nullptr};
+  NiceMock<MockStream> *mock{nullptr};
+
+  void SetUp() override {
+    FreeRTOSTest::SetUp();
+    gsm = new AsyncGSM();
+    mock = new NiceMock<MockStream>();
+    mock->SetupDefaults();
+  }
+  void TearDown() override {
+    if (gsm) {
+      gsm->context().end();
+      vTaskDelay(pdMS_TO_TICKS(80));
+      delete gsm;
+    }
+    if (mock) delete mock;
+    FreeRTOSTest::TearDown();
+  }
+};
+
+TEST_F(ChunkedSendTest, LargeWriteIsSplitIntoModemSizedSegments) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mock));
+
+        std::atomic<bool> done{false};
+        SendCapture cap;
+        startSegmentingResponder(mock, &done, &cap);
+        ASSERT_TRUE(gsm->connect("example.com", 80));
+
+        std::vector<uint8_t> body = makeBody(4000);
+        EXPECT_EQ(gsm->write(body.data(), body.size()), body.size());
+
+        ASSERT_EQ(cap.segments.size(), 3u);
+        EXPECT_EQ(cap.segments[0], 1460u);
+        EXPECT_EQ(cap.segments[1], 1460u);
+        EXPECT_EQ(cap.segments[2], 1080u);
+        EXPECT_EQ(cap.payload, std::string(body.begin(), body.end()));
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "ChunkedSend", 8192, 2, 10000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(ChunkedSendTest, ReportsBytesAcceptedBeforeFailure) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mock));
+
+        std::atomic<bool> done{false};
+        SendCapture cap;
+        cap.rejectSegment = 2;
+        startSegmentingResponder(mock, &done, &cap);
+        ASSERT_TRUE(gsm->connect("example.com", 80));
+
+        std::vector<uint8_t> body = makeBody(5000);
+        EXPECT_EQ(gsm->write(body.data(), body.size()), 2920u);
+
+        // Nothing is sent after the rejected segment
+        EXPECT_EQ(cap.segments.size(), 3u);
+        EXPECT_EQ(cap.payload.size(), 2920u);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "ChunkedSendFail", 8192, 2, 10000);
+  EXPECT_TRUE(ok);
+}
+
+FREERTOS_TEST_MAIN()
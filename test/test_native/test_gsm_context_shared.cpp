@@ -76,9 +76,9 @@ TEST_F(GsmContextSharedTest, SharedContextByInstances) {
 
         EXPECT_EQ(a.connect("example.com", 80), 1);
         vTaskDelay(pdMS_TO_TICKS(50));
-        // Ensure only AsyncGSM instance is connected (TCP)
+        // Ensure only AsyncGSM instance is connected (TCP); b owns a different connectID
         EXPECT_TRUE(a.connected());
-        EXPECT_TRUE(b.connected());
+        EXPECT_FALSE(b.connected());
 
         a.stop();
         // Wait up to 500ms for URC to mark disconnected
@@ -131,7 +131,7 @@ TEST_F(GsmContextSharedTest, SharedContextByPointerAndMix) {
           EXPECT_EQ(a->connect("example.com", 80), 1);
           vTaskDelay(pdMS_TO_TICKS(50));
           EXPECT_TRUE(a->connected());
-          EXPECT_TRUE(b.connected());
+          EXPECT_FALSE(b.connected());
 
           a->stop();
           vTaskDelay(pdMS_TO_TICKS(50));
@@ -0,0 +1,355 @@
+#include <AsyncMqttGSM.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "common/alloc_counter.h"
+#include "common/common.h"
+#include "common/responder.h"
+
+using ::testing::NiceMock;
+
+// Broker side of AT+QMTPUBEX: prompts for the payload, accepts it and acks each msgId
+struct PublishBroker {
+  std::vector<std::string> commands;  // Every AT+QMTPUBEX as sent
+  std::vector<int> msgIds;            // In the order the publishes reached the modem
+  std::string lastPayload;            // Bytes that followed the most recent prompt
+  std::set<int> rejectIds;  // Acked with result 2
+  std::atomic<bool> holdAcks{false};
+  uint32_t ackDelayMs{0};  // Simulated broker round trip
+  std::atomic<int> maxInFlight{0};
+};
+
+static void startPublishResponder(
+    NiceMock<MockStream> *s, std::atomic<bool> *done, PublishBroker *broker) {
+  auto responder = [](void *pv) {
+    using Ctx = std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, PublishBroker *>;
+    auto *ctx = static_cast<Ctx *>(pv);
+    auto *s = std::get<0>(*ctx);
+    auto *done = std::get<1>(*ctx);
+    auto *broker = std::get<2>(*ctx);
+
+    std::string acc;
+    size_t pending = 0;  // Payload bytes still expected after a '>' prompt
+    bool inPayload = false;
+    std::vector<std::pair<int, TickType_t>> unacked;  // msgId and when its payload arrived
+    TickType_t start = xTaskGetTickCount();
+    const TickType_t maxTicks = pdMS_TO_TICKS(10000);
+    while (!done->load()) {
+      if ((xTaskGetTickCount() - start) > maxTicks) break;
+
+      std::string chunk = DrainTx(s);
+      if (!chunk.empty()) acc += chunk;
+
+      bool progressed = true;
+      while (progressed) {
+        progressed = false;
+        // The payload is raw bytes of the announced length; CR, LF and NUL are data here
+        if (inPayload) {
+          if (acc.size() < pending) break;
+          broker->lastPayload = acc.substr(0, pending);
+          acc.erase(0, pending);
+          inPayload = false;
+          progressed = true;
+          InjectRx(s, "OK\r\n");
+          // QoS 0 (msgId 0) does not count against the publish window
+          int inFlight = static_cast<int>(std::count_if(
+              unacked.begin(), unacked.end(), [](const auto &u) { return u.first != 0; }));
+          if (inFlight > broker->maxInFlight.load()) broker->maxInFlight = inFlight;
+          continue;
+        }
+
+        size_t pos = acc.find("\r\n");
+        if (pos == std::string::npos) break;
+        std::string cmd = acc.substr(0, pos);
+        acc.erase(0, pos + 2);
+        progressed = true;
+
+        if (cmd.rfind("AT+QMTPUBEX=1,", 0) == 0) {
+          int id = std::stoi(cmd.substr(14));
+          broker->commands.push_back(cmd);
+          broker->msgIds.push_back(id);
+          unacked.emplace_back(id, xTaskGetTickCount());
+          pending = std::stoul(cmd.substr(cmd.rfind(',') + 1));
+          inPayload = true;
+          InjectRx(s, ">\r\n");
+          continue;
+        }
+        if (cmd.rfind("AT+", 0) == 0) { InjectRx(s, "OK\r\n"); }
+      }
+
+      // Released acks go out newest first to show completion is matched by msgId
+      if (!broker->holdAcks.load() && !inPayload) {
+        TickType_t now = xTaskGetTickCount();
+        for (size_t i = unacked.size(); i-- > 0;) {
+          if (now - unacked[i].second < pdMS_TO_TICKS(broker->ackDelayMs)) continue;
+          int id = unacked[i].first;
+          unacked.erase(unacked.begin() + i);
+          int result = broker->rejectIds.count(id) ? 2 : 0;
+          InjectRx(
+              s, "\r\n+QMTPUBEX: 1," + std::to_string(id) + "," + std::to_string(result) + "\r\n");
+        }
+      }
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    delete ctx;
+    vTaskDelete(nullptr);
+  };
+  auto *ctx = new std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, PublishBroker *>(
+      s, done, broker);
+  xTaskCreate(responder, "PUB_RESP", configMINIMAL_STACK_SIZE * 4, ctx, 3, nullptr);
+  vTaskDelay(pdMS_TO_TICKS(5));
+}
+
+class MqttPublishTest : public FreeRTOSTest {
+ protected:
+  GSMContext *ctx{nullptr};
+  NiceMock<MockStream> *mock{nullptr};
+  AsyncMqttGSM *mqtt{nullptr};
+
+  void SetUp() override {
+    FreeRTOSTest::SetUp();
+    ctx = new GSMContext();
+    mock = new NiceMock<MockStream>();
+    mock->SetupDefaults();
+    mqtt = new AsyncMqttGSM(*ctx);
+  }
+  void TearDown() override {
+    if (ctx) {
+      ctx->end();
+      vTaskDelay(pdMS_TO_TICKS(50));
+    }
+    if (mqtt) delete mqtt;
+    if (ctx) delete ctx;
+    if (mock) delete mock;
+    FreeRTOSTest::TearDown();
+  }
+};
+
+TEST_F(MqttPublishTest, WindowHandsOutUniqueIdsAndLimitsInFlight) {
+  bool ok = runInFreeRTOSTask(
+      []() {
+        MqttPublishWindow window;
+        ASSERT_TRUE(window.setWindow(3));
+        int a = window.acquire(10);
+        int b = window.acquire(10);
+        int c = window.acquire(10);
+        EXPECT_GT(a, 0);
+        EXPECT_NE(a, b);
+        EXPECT_NE(b, c);
+        EXPECT_EQ(window.acquire(10), -1);
+        EXPECT_FALSE(window.setWindow(5));
+
+        // Acks free window positions in any order
+        window.complete(static_cast<uint16_t>(b), 0);
+        window.complete(static_cast<uint16_t>(c), 2);
+        EXPECT_GT(window.acquire(10), 0);
+        EXPECT_TRUE(window.wait(static_cast<uint16_t>(b), 10));
+        EXPECT_FALSE(window.wait(static_cast<uint16_t>(c), 10));
+
+        // A lost connection fails whatever is still outstanding
+        window.failAll();
+        EXPECT_FALSE(window.wait(static_cast<uint16_t>(a), 10));
+        EXPECT_EQ(window.inFlight(), 0);
+      },
+      "PubWindow", 8192, 2, 3000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttPublishTest, PublishAsyncPipelinesMessagesAndMatchesAcksById) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(ctx->begin(*mock));
+        std::atomic<bool> done{false};
+        PublishBroker broker;
+        broker.holdAcks = true;
+        startPublishResponder(mock, &done, &broker);
+
+        ASSERT_TRUE(mqtt->setPublishWindow(4));
+        const uint8_t payload[] = {'4', '2'};
+        std::vector<int> ids;
+        for (int i = 0; i < 4; ++i) {
+          int id = mqtt->publishAsync("/telemetry", payload, sizeof(payload));
+          ASSERT_GT(id, 0);
+          ids.push_back(id);
+        }
+
+        // All four reached the modem before the broker acked any of them
+        EXPECT_EQ(broker.maxInFlight.load(), 4);
+        EXPECT_EQ(broker.msgIds, ids);
+        EXPECT_EQ(std::set<int>(ids.begin(), ids.end()).size(), 4u);
+
+        broker.rejectIds.insert(ids[2]);
+        broker.holdAcks = false;
+        EXPECT_TRUE(mqtt->waitForPublish(ids[0], 2000));
+        EXPECT_TRUE(mqtt->waitForPublish(ids[1], 2000));
+        EXPECT_FALSE(mqtt->waitForPublish(ids[2], 2000));
+        EXPECT_TRUE(mqtt->waitForPublish(ids[3], 2000));
+
+        // The blocking API is a publishAsync plus its wait
+        EXPECT_TRUE(mqtt->publish("/telemetry", payload, sizeof(payload)));
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "PubPipeline", 8192, 2, 10000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttPublishTest, QosZeroDoesNotWaitForTheBroker) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(ctx->begin(*mock));
+        std::atomic<bool> done{false};
+        PublishBroker broker;
+        broker.holdAcks = true;
+        startPublishResponder(mock, &done, &broker);
+
+        const uint8_t payload[] = {'1'};
+        EXPECT_TRUE(mqtt->publish("/sensor", payload, sizeof(payload), 0, false));
+        EXPECT_EQ(mqtt->publishAsync("/sensor", payload, sizeof(payload), 0), 0);
+
+        ASSERT_EQ(broker.commands.size(), 2u);
+        EXPECT_EQ(broker.commands[0], "AT+QMTPUBEX=1,0,0,0,\"/sensor\",1");
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "PubQos0", 8192, 2, 10000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttPublishTest, QosTwoRetainedWaitsForCompletion) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(ctx->begin(*mock));
+        std::atomic<bool> done{false};
+        PublishBroker broker;
+        startPublishResponder(mock, &done, &broker);
+
+        const uint8_t payload[] = {'o', 'n'};
+        EXPECT_TRUE(mqtt->publish("/status", payload, sizeof(payload), 2, true));
+        ASSERT_EQ(broker.commands.size(), 1u);
+        EXPECT_EQ(
+            broker.commands[0],
+            "AT+QMTPUBEX=1," + std::to_string(broker.msgIds[0]) + ",2,1,\"/status\",2");
+
+        // A failed handshake is reported to the caller
+        broker.rejectIds.insert(broker.msgIds[0] + 1);
+        EXPECT_FALSE(mqtt->publish("/status", payload, sizeof(payload), 2, true));
+
+        EXPECT_FALSE(mqtt->publish("/status", payload, sizeof(payload), 3, false));
+        EXPECT_EQ(broker.commands.size(), 2u);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "PubQos2", 8192, 2, 10000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttPublishTest, BatchKeepsPipelineFullAndReportsEachMessage) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(ctx->begin(*mock));
+        std::atomic<bool> done{false};
+        PublishBroker broker;
+        broker.ackDelayMs = 100;
+        broker.rejectIds.insert(5);
+        startPublishResponder(mock, &done, &broker);
+
+        ASSERT_TRUE(mqtt->setPublishWindow(4));
+        const uint8_t payload[] = {'2', '1', '.', '5'};
+        MqttBatchMessage batch[12];
+        for (auto &msg : batch) {
+          msg.topic = "/channel";
+          msg.payload = payload;
+          msg.length = sizeof(payload);
+        }
+        batch[11].qos = 0;
+
+        EXPECT_EQ(mqtt->publishBatch(batch, 12), 11u);
+        for (int i = 0; i < 12; ++i) { EXPECT_EQ(batch[i].ok, i != 4) << "message " << i; }
+
+        // Eleven acked messages one round trip apart would take over a second
+        EXPECT_EQ(broker.maxInFlight.load(), 4);
+        EXPECT_GT(mqtt->lastBatchMs(), 0u);
+        EXPECT_LT(mqtt->lastBatchMs(), 800u);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "PubBatch", 8192, 2, 10000);
+  EXPECT_TRUE(ok);
+}
+
+// Stand-in for an encoded CBOR/protobuf body: every byte value, NULs and CR/LF included
+static std::vector<uint8_t> makeBinaryPayload(size_t len) {
+  std::vector<uint8_t> body(len);
+  for (size_t i = 0; i < len; ++i) { body[i] = static_cast<uint8_t>((i * 7) & 0xFF); }
+  return body;
+}
+
+TEST_F(MqttPublishTest, BinaryPayloadIsSentVerbatim) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(ctx->begin(*mock));
+        std::atomic<bool> done{false};
+        PublishBroker broker;
+        startPublishResponder(mock, &done, &broker);
+
+        const uint8_t payload[] = {0xA2, 0x00, '\r', '\n', 0x01, 0x00, 0xFF, '\n'};
+        EXPECT_TRUE(mqtt->publish("/cbor", payload, sizeof(payload)));
+        std::string expected(reinterpret_cast<const char *>(payload), sizeof(payload));
+        EXPECT_EQ(broker.lastPayload, expected);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "PubBinary", 8192, 2, 10000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttPublishTest, BenchmarkBinaryPayloads) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(ctx->begin(*mock));
+        std::atomic<bool> done{false};
+        PublishBroker broker;
+        startPublishResponder(mock, &done, &broker);
+
+        constexpr int kRounds = 10;
+        for (size_t size : {size_t(1024), size_t(8192)}) {
+          std::vector<uint8_t> body = makeBinaryPayload(size);
+          AllocSnapshot start = allocSnapshot();
+          auto t0 = std::chrono::steady_clock::now();
+          int delivered = 0;
+          for (int i = 0; i < kRounds; ++i) {
+            if (mqtt->publish("/bench", body.data(), body.size())) delivered++;
+          }
+          double ms =
+              std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0)
+                  .count();
+          // Process-wide, so the mock stream's and responder's copies are included
+          AllocSnapshot allocs = allocSince(start);
+          BENCH_LOG(
+              "[BENCH] publish %zu B: %.2f ms/msg, %.1f allocations (%.0f bytes) per message\n",
+              size, ms / kRounds, allocs.count / double(kRounds), allocs.bytes / double(kRounds));
+
+          EXPECT_EQ(delivered, kRounds);
+          EXPECT_EQ(broker.lastPayload, std::string(body.begin(), body.end()));
+        }
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "PubBench", 8192, 2, 20000);
+  EXPECT_TRUE(ok);
+}
+
+FREERTOS_TEST_MAIN()
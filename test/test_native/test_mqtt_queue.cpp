@@ -0,0 +1,161 @@
+#include <utils/MqttQueue/MqttQueue.h>
+
+#include <atomic>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "common/alloc_counter.h"
+#include "common/common.h"
+
+class MqttQueueTest : public FreeRTOSTest {};
+
+static MqttMessage makeMessage(const char *topic, uint8_t tag, size_t len = 4) {
+  MqttMessage msg;
+  msg.topic = topic;
+  msg.payload.assign(len, tag);
+  msg.length = len;
+  return msg;
+}
+
+TEST_F(MqttQueueTest, MovesMessagesThroughWithoutCopying) {
+  AtomicMqttQueue queue(4);
+  MqttMessage in = makeMessage("/a", 1, 1024);
+  const uint8_t *buffer = in.payload.data();
+  ASSERT_TRUE(queue.push(std::move(in)));
+  EXPECT_EQ(queue.size(), 1u);
+
+  MqttMessage out;
+  ASSERT_TRUE(queue.pop(out));
+  EXPECT_EQ(out.topic, String("/a"));
+  EXPECT_EQ(out.length, 1024u);
+  // The payload that arrives is the very buffer that was pushed
+  EXPECT_EQ(out.payload.data(), buffer);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.pop(out));
+}
+
+TEST_F(MqttQueueTest, DropNewestKeepsTheFirstMessages) {
+  AtomicMqttQueue queue(3, MqttOverflowPolicy::DROP_NEWEST);
+  for (uint8_t i = 0; i < 5; ++i) { queue.push(makeMessage("/t", i)); }
+  EXPECT_EQ(queue.dropped(), 2u);
+
+  MqttMessage out;
+  for (uint8_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(queue.pop(out));
+    EXPECT_EQ(out.payload[0], i);
+  }
+  EXPECT_FALSE(queue.pop(out));
+}
+
+TEST_F(MqttQueueTest, DropOldestKeepsTheLatestMessages) {
+  AtomicMqttQueue queue(3, MqttOverflowPolicy::DROP_OLDEST);
+  for (uint8_t i = 0; i < 5; ++i) { EXPECT_TRUE(queue.push(makeMessage("/t", i))); }
+  EXPECT_EQ(queue.dropped(), 2u);
+
+  MqttMessage out;
+  for (uint8_t i = 2; i < 5; ++i) {
+    ASSERT_TRUE(queue.pop(out));
+    EXPECT_EQ(out.payload[0], i);
+  }
+}
+
+TEST_F(MqttQueueTest, BlockWaitsForTheConsumer) {
+  bool ok = runInFreeRTOSTask(
+      []() {
+        AtomicMqttQueue queue(2, MqttOverflowPolicy::BLOCK);
+        ASSERT_TRUE(queue.push(makeMessage("/t", 0)));
+        ASSERT_TRUE(queue.push(makeMessage("/t", 1)));
+        // Times out while nobody consumes
+        EXPECT_FALSE(queue.push(makeMessage("/t", 2), pdMS_TO_TICKS(20)));
+        EXPECT_EQ(queue.dropped(), 1u);
+
+        auto consumer = [](void *pv) {
+          auto *q = static_cast<AtomicMqttQueue *>(pv);
+          vTaskDelay(pdMS_TO_TICKS(30));
+          MqttMessage out;
+          q->pop(out);
+          vTaskDelete(nullptr);
+        };
+        xTaskCreate(consumer, "Q_CONSUMER", configMINIMAL_STACK_SIZE * 2, &queue, 3, nullptr);
+        EXPECT_TRUE(queue.push(makeMessage("/t", 3), pdMS_TO_TICKS(500)));
+        EXPECT_EQ(queue.dropped(), 1u);
+        vTaskDelay(pdMS_TO_TICKS(10));
+      },
+      "QueueBlock", 8192, 2, 3000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttQueueTest, ConcurrentProducersLoseNothing) {
+  bool ok = runInFreeRTOSTask(
+      []() {
+        constexpr int kPerProducer = 500;
+        AtomicMqttQueue queue(8, MqttOverflowPolicy::BLOCK);
+        std::atomic<int> finished{0};
+
+        auto producer = [](void *pv) {
+          using Ctx = std::tuple<AtomicMqttQueue *, std::atomic<int> *, uint8_t>;
+          auto *ctx = static_cast<Ctx *>(pv);
+          for (int i = 0; i < kPerProducer; ++i) {
+            MqttMessage msg = makeMessage("/p", std::get<2>(*ctx), 2);
+            msg.payload[1] = static_cast<uint8_t>(i);
+            std::get<0>(*ctx)->push(std::move(msg), pdMS_TO_TICKS(2000));
+          }
+          std::get<1>(*ctx)->fetch_add(1);
+          delete ctx;
+          vTaskDelete(nullptr);
+        };
+        for (uint8_t id = 0; id < 2; ++id) {
+          auto *ctx = new std::tuple<AtomicMqttQueue *, std::atomic<int> *, uint8_t>(
+              &queue, &finished, id);
+          xTaskCreate(producer, "Q_PRODUCER", configMINIMAL_STACK_SIZE * 2, ctx, 2, nullptr);
+        }
+
+        // Each producer's messages must come out complete and in order
+        int next[2] = {0, 0};
+        int received = 0;
+        MqttMessage out;
+        TickType_t t0 = xTaskGetTickCount();
+        while (received < 2 * kPerProducer && (xTaskGetTickCount() - t0) < pdMS_TO_TICKS(5000)) {
+          if (!queue.pop(out)) {
+            vTaskDelay(1);
+            continue;
+          }
+          uint8_t id = out.payload[0];
+          ASSERT_LT(id, 2);
+          EXPECT_EQ(out.payload[1], static_cast<uint8_t>(next[id]));
+          next[id]++;
+          received++;
+        }
+        EXPECT_EQ(received, 2 * kPerProducer);
+        EXPECT_EQ(queue.dropped(), 0u);
+        while (finished.load() < 2) { vTaskDelay(1); }
+      },
+      "QueueConcurrent", 8192, 2, 8000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttQueueTest, PreallocatedSlotsRecycleBuffers) {
+  AtomicMqttQueue queue;
+  ASSERT_TRUE(queue.configure(4, MqttOverflowPolicy::DROP_NEWEST, 256));
+  EXPECT_EQ(queue.capacity(), 4u);
+
+  const std::vector<uint8_t> body(200, 0x5A);
+  MqttMessage producer;
+  MqttMessage consumer;
+  auto roundTrip = [&]() {
+    producer.payload.assign(body.begin(), body.end());
+    producer.length = body.size();
+    ASSERT_TRUE(queue.push(std::move(producer)));
+    ASSERT_TRUE(queue.pop(consumer));
+  };
+
+  // Once every buffer in circulation has grown to fit, traffic stays off the heap
+  for (int i = 0; i < 8; ++i) roundTrip();
+  AllocSnapshot start = allocSnapshot();
+  for (int i = 0; i < 100; ++i) roundTrip();
+  EXPECT_EQ(allocSince(start).count, 0u);
+  EXPECT_EQ(consumer.payload, body);
+}
+
+FREERTOS_TEST_MAIN()
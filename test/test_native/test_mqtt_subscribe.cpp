@@ -0,0 +1,310 @@
+#include <AsyncMqttGSM.h>
+
+#include <atomic>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "common/common.h"
+#include "common/responder.h"
+
+using ::testing::NiceMock;
+
+// Broker side of AT+QMTOPEN, AT+QMTCONN, AT+QMTSUB and AT+QMTUNSUB. SUBACKs go out ackDelayMs
+// after the request, so several requests can be outstanding at once.
+struct SubscribeBroker {
+  std::vector<std::vector<std::pair<std::string, int>>> requests;  // Filters of each AT+QMTSUB
+  size_t maxTopics{5};            // Commands with more filters are answered with ERROR
+  std::set<std::string> refused;  // Granted QoS 128
+  uint32_t ackDelayMs{0};
+  std::atomic<int> maxOutstanding{0};
+  std::atomic<int> opens{0};
+  std::atomic<int> connects{0};
+};
+
+static std::vector<std::pair<std::string, int>> parseFilters(const std::string &cmd) {
+  // AT+QMTSUB=1,<msgId>,"<topic>",<qos>[,"<topic>",<qos>...]
+  std::vector<std::pair<std::string, int>> filters;
+  size_t open = cmd.find('"');
+  while (open != std::string::npos) {
+    size_t close = cmd.find('"', open + 1);
+    filters.emplace_back(cmd.substr(open + 1, close - open - 1), std::stoi(cmd.substr(close + 2)));
+    open = cmd.find('"', close + 1);
+  }
+  return filters;
+}
+
+static void startSubscribeResponder(
+    NiceMock<MockStream> *s, std::atomic<bool> *done, SubscribeBroker *broker) {
+  auto responder = [](void *pv) {
+    using Ctx = std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, SubscribeBroker *>;
+    auto *ctx = static_cast<Ctx *>(pv);
+    auto *s = std::get<0>(*ctx);
+    auto *done = std::get<1>(*ctx);
+    auto *broker = std::get<2>(*ctx);
+
+    std::string acc;
+    std::string pendingUrc;  // Sent on the empty command that waits for it
+    std::vector<std::pair<std::string, TickType_t>> unacked;
+    TickType_t start = xTaskGetTickCount();
+    const TickType_t maxTicks = pdMS_TO_TICKS(15000);
+    while (!done->load()) {
+      if ((xTaskGetTickCount() - start) > maxTicks) break;
+
+      std::string chunk = DrainTx(s);
+      if (!chunk.empty()) acc += chunk;
+
+      size_t pos;
+      while ((pos = acc.find("\r\n")) != std::string::npos) {
+        std::string cmd = acc.substr(0, pos);
+        acc.erase(0, pos + 2);
+        auto starts_with = [&](const char *p) { return cmd.rfind(p, 0) == 0; };
+
+        if (starts_with("AT+QMTOPEN=")) {
+          InjectRx(s, "OK\r\n");
+          pendingUrc = "+QMTOPEN: 1,0\r\n";
+          broker->opens++;
+          continue;
+        }
+        if (starts_with("AT+QMTCONN=")) {
+          InjectRx(s, "OK\r\n");
+          pendingUrc = "+QMTCONN: 1,0,0\r\n";
+          broker->connects++;
+          continue;
+        }
+        if (starts_with("AT+QMTUNSUB=1,")) {
+          InjectRx(s, "OK\r\n");
+          InjectRx(s, "\r\n+QMTUNSUB: 1," + std::to_string(std::stoi(cmd.substr(14))) + ",0\r\n");
+          continue;
+        }
+        if (starts_with("AT+QMTSUB=1,")) {
+          auto filters = parseFilters(cmd);
+          broker->requests.push_back(filters);
+          if (filters.size() > broker->maxTopics) {
+            InjectRx(s, "ERROR\r\n");
+            continue;
+          }
+          std::string ack = "+QMTSUB: 1," + std::to_string(std::stoi(cmd.substr(12))) + ",0";
+          for (const auto &f : filters) {
+            ack += "," + std::to_string(broker->refused.count(f.first) ? 128 : f.second);
+          }
+          InjectRx(s, "OK\r\n");
+          unacked.emplace_back(ack + "\r\n", xTaskGetTickCount());
+          if (static_cast<int>(unacked.size()) > broker->maxOutstanding.load()) {
+            broker->maxOutstanding = static_cast<int>(unacked.size());
+          }
+          continue;
+        }
+        if (cmd.empty()) {
+          InjectRx(s, pendingUrc.empty() ? "OK\r\n" : pendingUrc);
+          pendingUrc.clear();
+          continue;
+        }
+        if (starts_with("AT")) { InjectRx(s, "OK\r\n"); }
+      }
+
+      TickType_t now = xTaskGetTickCount();
+      while (!unacked.empty() &&
+             now - unacked.front().second >= pdMS_TO_TICKS(broker->ackDelayMs)) {
+        InjectRx(s, "\r\n" + unacked.front().first);
+        unacked.erase(unacked.begin());
+      }
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    delete ctx;
+    vTaskDelete(nullptr);
+  };
+  auto *ctx = new std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, SubscribeBroker *>(
+      s, done, broker);
+  xTaskCreate(responder, "SUB_RESP", configMINIMAL_STACK_SIZE * 4, ctx, 3, nullptr);
+  vTaskDelay(pdMS_TO_TICKS(5));
+}
+
+class MqttSubscribeTest : public FreeRTOSTest {
+ protected:
+  GSMContext *ctx{nullptr};
+  NiceMock<MockStream> *mock{nullptr};
+  AsyncMqttGSM *mqtt{nullptr};
+  std::vector<std::string> topics;
+
+  void SetUp() override {
+    FreeRTOSTest::SetUp();
+    ctx = new GSMContext();
+    mock = new NiceMock<MockStream>();
+    mock->SetupDefaults();
+    mqtt = new AsyncMqttGSM(*ctx);
+  }
+  void TearDown() override {
+    if (ctx) {
+      ctx->end();
+      vTaskDelay(pdMS_TO_TICKS(50));
+    }
+    if (mqtt) delete mqtt;
+    if (ctx) delete ctx;
+    if (mock) delete mock;
+    FreeRTOSTest::TearDown();
+  }
+
+  // Subscribes to count topics one by one, with QoS cycling through 0, 1 and 2
+  void subscribeTopics(size_t count) {
+    topics.clear();
+    for (size_t i = 0; i < count; ++i) topics.push_back("site/sensor" + std::to_string(i));
+    for (size_t i = 0; i < count; ++i) {
+      ASSERT_TRUE(mqtt->subscribe(topics[i].c_str(), static_cast<uint8_t>(i % 3)));
+    }
+  }
+
+  // Drops the session and lets loop() reconnect and resubscribe
+  void dropAndRecover() {
+    mqtt->setCallback([](char *, uint8_t *, unsigned int) {});
+    ctx->modem().URCState.mqttState.store(MqttConnectionState::DISCONNECTED);
+    mqtt->loop();
+    mqtt->setCallback(nullptr);
+  }
+};
+
+TEST_F(MqttSubscribeTest, ReconnectResubscribesInBatchesAtOriginalQos) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(ctx->begin(*mock));
+        std::atomic<bool> done{false};
+        SubscribeBroker broker;
+        startSubscribeResponder(mock, &done, &broker);
+        ASSERT_TRUE(mqtt->setServer("broker", 1883).connect("dev", nullptr, nullptr));
+
+        subscribeTopics(42);
+        ASSERT_EQ(broker.requests.size(), 42u);
+        broker.requests.clear();
+        broker.maxOutstanding = 0;
+        broker.ackDelayMs = 50;
+
+        dropAndRecover();
+        EXPECT_TRUE(mqtt->connected());
+        EXPECT_EQ(broker.connects.load(), 2);
+        // Five filters per command, with a window's worth of commands awaiting SUBACK at once
+        ASSERT_EQ(broker.requests.size(), 9u);
+        EXPECT_EQ(broker.maxOutstanding.load(), 4);
+        size_t i = 0;
+        for (const auto &request : broker.requests) {
+          EXPECT_LE(request.size(), 5u);
+          for (const auto &filter : request) {
+            EXPECT_EQ(filter.first, topics[i]);
+            EXPECT_EQ(filter.second, static_cast<int>(i % 3));
+            i++;
+          }
+        }
+        EXPECT_EQ(i, topics.size());
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "SubBatch", 8192, 2, 15000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttSubscribeTest, FallsBackToSingleTopicCommands) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(ctx->begin(*mock));
+        std::atomic<bool> done{false};
+        SubscribeBroker broker;
+        broker.maxTopics = 1;
+        startSubscribeResponder(mock, &done, &broker);
+        ASSERT_TRUE(mqtt->setServer("broker", 1883).connect("dev", nullptr, nullptr));
+
+        subscribeTopics(7);
+        broker.requests.clear();
+
+        dropAndRecover();
+        // Two rejected batches of 5 and 2, then every filter on its own
+        ASSERT_EQ(broker.requests.size(), 9u);
+        EXPECT_EQ(broker.requests[0].size(), 5u);
+        EXPECT_EQ(broker.requests[1].size(), 2u);
+        for (size_t i = 0; i < topics.size(); ++i) {
+          ASSERT_EQ(broker.requests[2 + i].size(), 1u);
+          EXPECT_EQ(broker.requests[2 + i][0].first, topics[i]);
+          EXPECT_EQ(broker.requests[2 + i][0].second, static_cast<int>(i % 3));
+        }
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "SubFallback", 8192, 2, 15000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttSubscribeTest, RefusedFilterFailsOnlyItself) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(ctx->begin(*mock));
+        std::atomic<bool> done{false};
+        SubscribeBroker broker;
+        broker.refused.insert("site/sensor1");
+        startSubscribeResponder(mock, &done, &broker);
+        ASSERT_TRUE(mqtt->setServer("broker", 1883).connect("dev", nullptr, nullptr));
+
+        topics = {"site/sensor0", "site/sensor1", "site/sensor2"};
+        EXPECT_TRUE(mqtt->subscribe(topics[0].c_str(), 1));
+        EXPECT_FALSE(mqtt->subscribe(topics[1].c_str(), 1));
+        EXPECT_TRUE(mqtt->subscribe(topics[2].c_str(), 1));
+
+        // The refused filter sinks its batch, and the retry pins the failure on it alone
+        broker.requests.clear();
+        dropAndRecover();
+        ASSERT_EQ(broker.requests.size(), 4u);
+        EXPECT_EQ(broker.requests[0].size(), 3u);
+        EXPECT_EQ(broker.requests[2][0].first, "site/sensor1");
+
+        // Unsubscribed filters are left out of the next attempt
+        ASSERT_TRUE(mqtt->unsubscribe(topics[1].c_str()));
+        broker.requests.clear();
+        dropAndRecover();
+        ASSERT_EQ(broker.requests.size(), 1u);
+        EXPECT_EQ(broker.requests[0].size(), 2u);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "SubRefused", 8192, 2, 15000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttSubscribeTest, ReconnectResubscribesTopicsItOwns) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(ctx->begin(*mock));
+        std::atomic<bool> done{false};
+        SubscribeBroker broker;
+        startSubscribeResponder(mock, &done, &broker);
+        ASSERT_TRUE(mqtt->setServer("broker", 1883).connect("dev", nullptr, nullptr));
+
+        // Subscriptions keep their own copy of the topic
+        char topic[32];
+        for (int i = 0; i < 3; ++i) {
+          snprintf(topic, sizeof(topic), "site/sensor%d", i);
+          ASSERT_TRUE(mqtt->subscribe(topic, 1));
+        }
+        snprintf(topic, sizeof(topic), "overwritten");
+        broker.requests.clear();
+
+        // The link is gone once +QMTSTAT reported it: full handshake, then the resubscribe
+        dropAndRecover();
+        EXPECT_TRUE(mqtt->connected());
+        EXPECT_EQ(broker.opens.load(), 2);
+        EXPECT_EQ(broker.connects.load(), 2);
+        ASSERT_EQ(broker.requests.size(), 1u);
+        ASSERT_EQ(broker.requests[0].size(), 3u);
+        EXPECT_EQ(broker.requests[0][0].first, "site/sensor0");
+        EXPECT_EQ(broker.requests[0][2].first, "site/sensor2");
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "SubOwned", 8192, 2, 15000);
+  EXPECT_TRUE(ok);
+}
+
+FREERTOS_TEST_MAIN()
@@ -0,0 +1,83 @@
+#include <utils/MqttTopicRouter/MqttTopicRouter.h>
+
+#include <set>
+#include <string>
+
+#include "common/common.h"
+
+class MqttTopicRouterTest : public FreeRTOSTest {
+ protected:
+  MqttTopicRouter router;
+  std::multiset<std::string> hits;
+
+  MqttTopicHandler record(const char *name) {
+    return [this, name](char *, uint8_t *, unsigned int) { hits.insert(name); };
+  }
+
+  std::multiset<std::string> route(const char *topic) {
+    hits.clear();
+    std::string copy(topic);
+    size_t count = router.dispatch(&copy[0], nullptr, 0);
+    EXPECT_EQ(count, hits.size());
+    return hits;
+  }
+};
+
+using Hits = std::multiset<std::string>;
+
+TEST_F(MqttTopicRouterTest, MatchesExactAndWildcardFilters) {
+  ASSERT_TRUE(router.add("home/kitchen/temp", record("exact")));
+  ASSERT_TRUE(router.add("home/+/temp", record("plus")));
+  ASSERT_TRUE(router.add("home/#", record("hash")));
+  ASSERT_TRUE(router.add("+/+/+", record("levels")));
+  EXPECT_EQ(router.size(), 4u);
+
+  EXPECT_EQ(route("home/kitchen/temp"), Hits({"exact", "plus", "hash", "levels"}));
+  EXPECT_EQ(route("home/garage/temp"), Hits({"plus", "hash", "levels"}));
+  EXPECT_EQ(route("home/garage/door/state"), Hits({"hash"}));
+  // '#' also covers its parent level
+  EXPECT_EQ(route("home"), Hits({"hash"}));
+  EXPECT_EQ(route("office/desk/temp"), Hits({"levels"}));
+  EXPECT_EQ(route("office/desk"), Hits());
+  // Empty levels are levels too
+  EXPECT_EQ(route("home//temp"), Hits({"plus", "hash", "levels"}));
+}
+
+TEST_F(MqttTopicRouterTest, WildcardsSkipSystemTopics) {
+  ASSERT_TRUE(router.add("#", record("all")));
+  ASSERT_TRUE(router.add("+/broker/load", record("plus")));
+  ASSERT_TRUE(router.add("$SYS/#", record("sys")));
+
+  EXPECT_EQ(route("$SYS/broker/load"), Hits({"sys"}));
+  EXPECT_EQ(route("app/broker/load"), Hits({"all", "plus"}));
+}
+
+TEST_F(MqttTopicRouterTest, RejectsMalformedFilters) {
+  EXPECT_FALSE(router.add("", record("x")));
+  EXPECT_FALSE(router.add("a/#/b", record("x")));
+  EXPECT_FALSE(router.add("a/b#", record("x")));
+  EXPECT_FALSE(router.add("a/+b/c", record("x")));
+  EXPECT_FALSE(router.add("a/b", nullptr));
+  EXPECT_EQ(router.size(), 0u);
+}
+
+TEST_F(MqttTopicRouterTest, ReplacesAndRemovesHandlers) {
+  ASSERT_TRUE(router.add("a/+", record("first")));
+  ASSERT_TRUE(router.add("a/+", record("second")));
+  ASSERT_TRUE(router.add("a/b", record("exact")));
+  EXPECT_EQ(router.size(), 2u);
+  EXPECT_EQ(route("a/b"), Hits({"second", "exact"}));
+
+  EXPECT_TRUE(router.remove("a/+"));
+  EXPECT_FALSE(router.remove("a/+"));
+  EXPECT_FALSE(router.contains("a/+"));
+  EXPECT_TRUE(router.contains("a/b"));
+  EXPECT_EQ(route("a/b"), Hits({"exact"}));
+  EXPECT_EQ(route("a/c"), Hits());
+
+  EXPECT_TRUE(router.remove("a/b"));
+  EXPECT_EQ(router.size(), 0u);
+  EXPECT_EQ(route("a/b"), Hits());
+}
+
+FREERTOS_TEST_MAIN()
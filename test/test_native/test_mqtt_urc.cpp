@@ -2,22 +2,31 @@
 #include <AsyncMqttGSM.h>
 
 #include <atomic>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/responder.h"
 
 using ::testing::NiceMock;
 
+// Messages held in the modem's buffer by recv_id, as AT+QMTRECV=1,<id> returns them
+using MqttRecvReplies = std::map<int, std::string>;
+
 static void startMqttCfgResponder(
-    NiceMock<MockStream> *s, std::atomic<bool> *done, std::string *capture = nullptr) {
+    NiceMock<MockStream> *s, std::atomic<bool> *done, std::string *capture = nullptr,
+    const MqttRecvReplies *recv = nullptr) {
   auto responder = [](void *pv) {
-    using Ctx =
-        std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, std::string *, std::atomic<bool> *>;
+    using Ctx = std::tuple<
+        NiceMock<MockStream> *, std::atomic<bool> *, std::string *, std::atomic<bool> *,
+        const MqttRecvReplies *>;
     auto *ctx = static_cast<Ctx *>(pv);
     auto *s = std::get<0>(*ctx);
     auto *done = std::get<1>(*ctx);
     auto *cap = std::get<2>(*ctx);
     auto *started = std::get<3>(*ctx);
+    auto *recv = std::get<4>(*ctx);
 
     std::string acc;
     TickType_t start = xTaskGetTickCount();
@@ -44,6 +53,25 @@ static void startMqttCfgResponder(
           InjectRx(s, "OK\r\n");
           continue;
         }
+        // SUBACK and UNSUBACK go to the URC handler
+        if (starts_with("AT+QMTSUB=1,")) {
+          InjectRx(s, "OK\r\n");
+          InjectRx(s, "+QMTSUB: 1," + std::to_string(std::stoi(cmd.substr(12))) + ",0,1\r\n");
+          continue;
+        }
+        if (starts_with("AT+QMTUNSUB=1,")) {
+          InjectRx(s, "OK\r\n");
+          InjectRx(s, "+QMTUNSUB: 1," + std::to_string(std::stoi(cmd.substr(14))) + ",0\r\n");
+          continue;
+        }
+        // Hands out a buffered message, the OK after it ending the command
+        if (starts_with("AT+QMTRECV=1,") && recv) {
+          auto it = recv->find(std::stoi(cmd.substr(13)));
+          if (it != recv->end()) {
+            InjectRx(s, "\r\n" + it->second + "\r\n\r\nOK\r\n");
+            continue;
+          }
+        }
         // Accept empty lines used for expect chains
         if (cmd.empty()) {
           InjectRx(s, "OK\r\n");
@@ -63,8 +91,8 @@ static void startMqttCfgResponder(
   };
   auto *started = new std::atomic<bool>(false);
   auto *_ctx = new std::tuple<
-      NiceMock<MockStream> *, std::atomic<bool> *, std::string *, std::atomic<bool> *>(
-      s, done, capture, started);
+      NiceMock<MockStream> *, std::atomic<bool> *, std::string *, std::atomic<bool> *,
+      const MqttRecvReplies *>(s, done, capture, started, recv);
   xTaskCreate(responder, "MQTT_CFG_RESP", configMINIMAL_STACK_SIZE * 4, _ctx, 1, nullptr);
   TickType_t t0 = xTaskGetTickCount();
   while (!started->load() && (xTaskGetTickCount() - t0) < pdMS_TO_TICKS(50)) {
@@ -114,12 +142,20 @@ TEST_F(MqttURCTest, QMTRECV_HeaderOnly_RequestsFetch) {
         // Clear any previous TX
         (void)mock->GetTxData();
 
-        // Inject a header-only QMTRECV URC to request fetch
+        gsm->context().modem().URCState.mqttState.store(MqttConnectionState::CONNECTED);
+        mqtt->setCallback([](char *, uint8_t *, unsigned int) {});
+
+        // The notice is only recorded on the reader task
         InjectRx(mock, "\r\n+QMTRECV: 1,7\r\n");
         vTaskDelay(pdMS_TO_TICKS(30));
+        EXPECT_NE(cap.find("AT+QMTCFG=\"recv/mode\",1,1,1"), std::string::npos);
+        EXPECT_EQ(cap.find("AT+QMTRECV="), std::string::npos);
 
-        // Check captured outgoing commands from responder
-        EXPECT_NE(cap.find("AT+QMTRECV=1,7"), std::string::npos);
+        // loop() fetches it through the AT handler
+        mqtt->loop();
+        vTaskDelay(pdMS_TO_TICKS(30));
+        EXPECT_NE(cap.find("AT+QMTRECV=1,7\r\n"), std::string::npos);
+        mqtt->setCallback(nullptr);
 
         done = true;
         vTaskDelay(pdMS_TO_TICKS(50));
@@ -168,6 +204,252 @@ TEST_F(MqttURCTest, QMTRECV_WithTopicPayload_QueuesAndCallback) {
   EXPECT_TRUE(ok);
 }
 
+// Collects messages delivered through loop() until count arrive or the wait runs out
+static std::vector<std::pair<std::string, std::string>> pumpMessages(
+    AsyncMqttGSM *mqtt, size_t count) {
+  std::vector<std::pair<std::string, std::string>> got;
+  mqtt->setCallback([&](char *topic, uint8_t *payload, unsigned int len) {
+    got.emplace_back(topic, std::string(reinterpret_cast<char *>(payload), len));
+  });
+  for (int i = 0; i < 50 && got.size() < count; ++i) {
+    mqtt->loop();
+    vTaskDelay(pdMS_TO_TICKS(20));
+  }
+  mqtt->setCallback(nullptr);
+  return got;
+}
+
+TEST_F(MqttURCTest, QMTRECV_LengthPrefixedPayloadKeepsQuotesAndCommas) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        gsm->context().modem().URCState.mqttState.store(MqttConnectionState::CONNECTED);
+
+        const std::string payload = "{\"k\":\"v,\\\"w\\\"\"}";
+        std::atomic<bool> done{false};
+        MqttRecvReplies recv;
+        recv[5] =
+            "+QMTRECV: 1,5,\"/cfg\"," + std::to_string(payload.size()) + ",\"" + payload + "\"";
+        startMqttCfgResponder(mock, &done, nullptr, &recv);
+        InjectRx(
+            mock, "\r\n+QMTRECV: 1,4,\"/cfg\"," + std::to_string(payload.size()) + ",\"" + payload +
+                      "\"\r\nOK\r\n");
+
+        auto got = pumpMessages(mqtt, 1);
+        ASSERT_EQ(got.size(), 1u);
+        EXPECT_EQ(got[0].first, "/cfg");
+        EXPECT_EQ(got[0].second, payload);
+
+        // The same message fetched from the modem's buffer
+        InjectRx(mock, "\r\n+QMTRECV: 1,5\r\n");
+
+        got = pumpMessages(mqtt, 1);
+        ASSERT_EQ(got.size(), 1u);
+        EXPECT_EQ(got[0].first, "/cfg");
+        EXPECT_EQ(got[0].second, payload);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "MQTT_QMTRECV_LEN", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttURCTest, QMTRECV_LargePayloadSpanningLinesArrivesIntact) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        gsm->context().modem().URCState.mqttState.store(MqttConnectionState::CONNECTED);
+
+        // A 12 KB pretty-printed config push fetched from the modem's buffer: the line breaks
+        // inside the payload, bare CR or LF included, come through byte for byte
+        std::string payload;
+        while (payload.size() < 12 * 1024) {
+          payload += "  \"key" + std::to_string(payload.size()) + "\": \"value\",\r\n";
+        }
+        payload += "\n \r\n\r";
+        std::atomic<bool> done{false};
+        MqttRecvReplies recv;
+        recv[5] = "+QMTRECV: 1,5,\"/config\"," + std::to_string(payload.size()) + ",\"" + payload +
+                  "\"";
+        recv[6] = "+QMTRECV: 1,6,\"/next\",2,\"ok\"";
+        startMqttCfgResponder(mock, &done, nullptr, &recv);
+        InjectRx(mock, "\r\n+QMTRECV: 1,5\r\n");
+
+        auto got = pumpMessages(mqtt, 1);
+        ASSERT_EQ(got.size(), 1u);
+        EXPECT_EQ(got[0].first, "/config");
+        EXPECT_EQ(got[0].second.size(), payload.size());
+        EXPECT_EQ(got[0].second, payload);
+
+        // The stream is still in sync for the next message
+        InjectRx(mock, "\r\n+QMTRECV: 1,6\r\n");
+        got = pumpMessages(mqtt, 1);
+        ASSERT_EQ(got.size(), 1u);
+        EXPECT_EQ(got[0].first, "/next");
+        EXPECT_EQ(got[0].second, "ok");
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "MQTT_QMTRECV_BIG", 8192, 3, 10000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttURCTest, QMTRECV_BackToBackNoticesFetchBothMessages) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        gsm->context().modem().URCState.mqttState.store(MqttConnectionState::CONNECTED);
+
+        std::atomic<bool> done{false};
+        std::string cap;
+        MqttRecvReplies recv;
+        recv[0] = "+QMTRECV: 1,0,\"/a\",5,\"first\"";
+        recv[1] = "+QMTRECV: 1,1,\"/b\",6,\"second\"";
+        startMqttCfgResponder(mock, &done, &cap, &recv);
+
+        // Neither notice is lost to the other, nor to the +QMTPUBEX and +QIURC lines around them
+        InjectRx(
+            mock,
+            "\r\n+QMTRECV: 1,0\r\n\r\n+QMTRECV: 1,1\r\n\r\n+QMTPUBEX: 1,3,0\r\n"
+            "\r\n+QIURC: \"recv\",2\r\n");
+        vTaskDelay(pdMS_TO_TICKS(30));
+        EXPECT_EQ(cap.find("AT+QMTRECV="), std::string::npos);
+
+        auto got = pumpMessages(mqtt, 2);
+        ASSERT_EQ(got.size(), 2u);
+        EXPECT_EQ(got[0], std::make_pair(std::string("/a"), std::string("first")));
+        EXPECT_EQ(got[1], std::make_pair(std::string("/b"), std::string("second")));
+        EXPECT_LT(cap.find("AT+QMTRECV=1,0\r\n"), cap.find("AT+QMTRECV=1,1\r\n"));
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "MQTT_QMTRECV_TWO", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttURCTest, DispatchTask_DeliversWithoutPolling) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        gsm->context().modem().URCState.mqttState.store(MqttConnectionState::CONNECTED);
+
+        std::atomic<int> calls{0};
+        std::atomic<TickType_t> deliveredAt{0};
+        std::string gotTopic;
+        std::string gotPayload;
+        mqtt->setCallback([&](char *topic, uint8_t *payload, unsigned int len) {
+          gotTopic = topic;
+          gotPayload.assign(reinterpret_cast<char *>(payload), len);
+          deliveredAt = xTaskGetTickCount();
+          calls++;
+        });
+        ASSERT_TRUE(mqtt->startDispatchTask());
+
+        TickType_t sentAt = xTaskGetTickCount();
+        InjectRx(mock, "\r\n+QMTRECV: 1,8,\"/cmd\",6,\"reboot\"\r\nOK\r\n");
+        for (int i = 0; i < 100 && calls.load() == 0; ++i) { vTaskDelay(pdMS_TO_TICKS(2)); }
+
+        // Delivered on URC arrival; loop() was never called
+        ASSERT_EQ(calls.load(), 1);
+        EXPECT_EQ(gotTopic, "/cmd");
+        EXPECT_EQ(gotPayload, "reboot");
+        EXPECT_LT(deliveredAt.load() - sentAt, pdMS_TO_TICKS(100));
+
+        // With the task running loop() leaves the queue alone
+        mqtt->loop();
+        EXPECT_EQ(calls.load(), 1);
+
+        // The ring is not rebuilt under the task's feet
+        EXPECT_FALSE(mqtt->setReceiveQueue(4));
+        mqtt->stopDispatchTask();
+        EXPECT_TRUE(mqtt->setReceiveQueue(4));
+        mqtt->setCallback(nullptr);
+      },
+      "MQTT_DISPATCH", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttURCTest, DispatchTask_StopWaitsForRunningHandler) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        gsm->context().modem().URCState.mqttState.store(MqttConnectionState::CONNECTED);
+
+        std::atomic<bool> entered{false};
+        std::atomic<bool> finished{false};
+        mqtt->setCallback([&](char *, uint8_t *, unsigned int) {
+          entered = true;
+          vTaskDelay(pdMS_TO_TICKS(1500));
+          finished = true;
+        });
+        ASSERT_TRUE(mqtt->startDispatchTask());
+        InjectRx(mock, "\r\n+QMTRECV: 1,8,\"/cmd\",4,\"slow\"\r\n");
+        for (int i = 0; i < 100 && !entered.load(); ++i) { vTaskDelay(pdMS_TO_TICKS(2)); }
+        ASSERT_TRUE(entered.load());
+
+        // Outlasts the first wait, yet nothing is torn down under the handler
+        mqtt->stopDispatchTask();
+        EXPECT_TRUE(finished.load());
+        mqtt->setCallback(nullptr);
+      },
+      "MQTT_DISPATCH_STOP", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MqttURCTest, Subscribe_RoutesWildcardFiltersToHandlers) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        std::atomic<bool> done{false};
+        std::string cap;
+        startMqttCfgResponder(mock, &done, &cap);
+        gsm->context().modem().URCState.mqttState.store(MqttConnectionState::CONNECTED);
+
+        std::vector<std::string> commands;
+        std::vector<std::string> everything;
+        std::vector<std::string> unmatched;
+        ASSERT_TRUE(mqtt->subscribe("dev/+/cmd", 1, [&](char *topic, uint8_t *, unsigned int) {
+          commands.emplace_back(topic);
+        }));
+        ASSERT_TRUE(mqtt->subscribe("dev/#", 0, [&](char *topic, uint8_t *, unsigned int) {
+          everything.emplace_back(topic);
+        }));
+        mqtt->setCallback(
+            [&](char *topic, uint8_t *, unsigned int) { unmatched.emplace_back(topic); });
+        EXPECT_NE(cap.find(",\"dev/+/cmd\",1\r\n"), std::string::npos);
+        EXPECT_NE(cap.find(",\"dev/#\",0\r\n"), std::string::npos);
+
+        InjectRx(mock, "\r\n+QMTRECV: 1,1,\"dev/42/cmd\",2,\"on\"\r\n");
+        InjectRx(mock, "\r\n+QMTRECV: 1,2,\"dev/42/status\",2,\"up\"\r\n");
+        InjectRx(mock, "\r\n+QMTRECV: 1,3,\"other\",2,\"hi\"\r\n");
+        for (int i = 0; i < 50 && everything.size() + unmatched.size() < 3; ++i) {
+          mqtt->loop();
+          vTaskDelay(pdMS_TO_TICKS(10));
+        }
+
+        // Both filters see the command; the callback only gets what no filter claimed
+        EXPECT_EQ(commands, std::vector<std::string>({"dev/42/cmd"}));
+        EXPECT_EQ(everything, std::vector<std::string>({"dev/42/cmd", "dev/42/status"}));
+        EXPECT_EQ(unmatched, std::vector<std::string>({"other"}));
+
+        ASSERT_TRUE(mqtt->unsubscribe("dev/#"));
+        // The msgId comes from the window the subscribes used
+        size_t unsub = cap.rfind("AT+QMTUNSUB=1,");
+        ASSERT_NE(unsub, std::string::npos);
+        EXPECT_EQ(cap.find(",\"dev/#\"\r\n", unsub), cap.find(',', unsub + 14));
+        InjectRx(mock, "\r\n+QMTRECV: 1,4,\"dev/42/status\",2,\"up\"\r\n");
+        for (int i = 0; i < 50 && unmatched.size() < 2; ++i) {
+          mqtt->loop();
+          vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        EXPECT_EQ(everything.size(), 2u);
+        EXPECT_EQ(unmatched, std::vector<std::string>({"other", "dev/42/status"}));
+
+        mqtt->setCallback(nullptr);
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "MQTT_ROUTER", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
 TEST_F(MqttURCTest, QMTSTAT_SetsDisconnected) {
   bool ok = runInFreeRTOSTask(
       [this]() {
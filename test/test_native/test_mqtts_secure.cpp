@@ -23,7 +23,8 @@ static void startMqttsResponder(
     const TickType_t maxTicks = pdMS_TO_TICKS(10000);
     bool lastOpen = false;
     bool lastConn = false;
-    bool lastPub = false;
+    std::string lastPubId;
+    size_t pubPending = 0;
 
     while (!done->load()) {
       if ((xTaskGetTickCount() - start) > maxTicks) break;
@@ -31,8 +32,21 @@ static void startMqttsResponder(
       std::string chunk = DrainTx(s);
       if (!chunk.empty()) acc += chunk;
 
+      // MQTT payloads are raw bytes of the announced length with no line terminator
+      if (pubPending > 0) {
+        if (acc.size() < pubPending) {
+          vTaskDelay(pdMS_TO_TICKS(1));
+          continue;
+        }
+        acc.erase(0, pubPending);
+        pubPending = 0;
+        InjectRx(s, "OK\r\n");
+        // The broker ack follows as a URC
+        InjectRx(s, "+QMTPUBEX: 1," + lastPubId + ",0\r\n");
+      }
+
       size_t pos;
-      while ((pos = acc.find("\r\n")) != std::string::npos) {
+      while (pubPending == 0 && (pos = acc.find("\r\n")) != std::string::npos) {
         std::string cmd = acc.substr(0, pos);
         acc.erase(0, pos + 2);
         if (cap) {
@@ -77,8 +91,11 @@ static void startMqttsResponder(
 
         // Publish extended
         if (sw("AT+QMTPUBEX=")) {
+          // AT+QMTPUBEX=<cidx>,<msgid>,...
+          size_t idStart = cmd.find(',') + 1;
+          lastPubId = cmd.substr(idStart, cmd.find(',', idStart) - idStart);
+          pubPending = std::stoul(cmd.substr(cmd.rfind(',') + 1));
           InjectRx(s, ">\r\n");
-          lastPub = true;
           continue;
         }
         if (!cmd.empty() && cmd[0] != 'A') {
@@ -98,11 +115,6 @@ static void startMqttsResponder(
             lastConn = false;
             continue;
           }
-          if (lastPub) {
-            InjectRx(s, "+QMTPUBEX: 1,1,0\r\n");
-            lastPub = false;
-            continue;
-          }
           InjectRx(s, "OK\r\n");
           continue;
         }
@@ -174,7 +186,8 @@ TEST_F(MqttsTest, ConnectPublishOverTls) {
       [this]() {
         ASSERT_TRUE(ctx->begin(*mock));
         std::atomic<bool> done{false};
-        startMqttsResponder(mock, &done);
+        std::string cap;
+        startMqttsResponder(mock, &done, &cap);
 
         const char* pem = "-----BEGIN CERTIFICATE-----\nXYZ\n-----END CERTIFICATE-----\n";
         mqtts->setCACert(pem);
@@ -186,6 +199,18 @@ TEST_F(MqttsTest, ConnectPublishOverTls) {
         const char* topic = "/t";
         const uint8_t payload[] = {'o', 'k'};
         ASSERT_TRUE(mqtts->publish(topic, payload, 2));
+        ASSERT_TRUE(mqtts->publish(topic, payload, 2));
+
+        // The client's SSL binding goes out once, not before every publish
+        auto count = [&](const std::string& needle) {
+          size_t n = 0;
+          for (size_t p = cap.find(needle); p != std::string::npos; p = cap.find(needle, p + 1)) {
+            n++;
+          }
+          return n;
+        };
+        EXPECT_EQ(count("AT+QMTCFG=\"ssl\",1,1,2"), 1u);
+        EXPECT_EQ(count("AT+QSSLCFG=\"cacert\""), 1u);
 
         done = true;
         vTaskDelay(pdMS_TO_TICKS(50));
@@ -0,0 +1,205 @@
+#include <AsyncGSM.h>
+
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+
+#include "common/common.h"
+#include "common/responder.h"
+
+using ::testing::NiceMock;
+
+// Per-connectID payloads served by the responder on AT+QIRD=<id>,<len>; reads on failing
+// connectIDs are answered with ERROR
+struct SocketPayloads {
+  std::map<int, std::string> bodies;
+  std::set<int> failing;
+};
+
+static void startMultiSocketResponder(
+    NiceMock<MockStream> *s, std::atomic<bool> *done, SocketPayloads *payloads) {
+  auto responder = [](void *pv) {
+    using Ctx = std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, SocketPayloads *>;
+    auto *ctx = static_cast<Ctx *>(pv);
+    auto *s = std::get<0>(*ctx);
+    auto *done = std::get<1>(*ctx);
+    auto *payloads = std::get<2>(*ctx);
+
+    std::string acc;
+    TickType_t start = xTaskGetTickCount();
+    const TickType_t maxTicks = pdMS_TO_TICKS(10000);
+    while (!done->load()) {
+      if ((xTaskGetTickCount() - start) > maxTicks) break;
+
+      std::string chunk = DrainTx(s);
+      if (!chunk.empty()) acc += chunk;
+
+      size_t pos;
+      while ((pos = acc.find("\r\n")) != std::string::npos) {
+        std::string cmd = acc.substr(0, pos);
+        acc.erase(0, pos + 2);
+        auto starts_with = [&](const char *p) { return cmd.rfind(p, 0) == 0; };
+
+        if (starts_with("AT+QIOPEN=1,")) {
+          int id = std::stoi(cmd.substr(12));
+          InjectRx(s, "OK\r\n");
+          InjectRx(s, "+QIOPEN: " + std::to_string(id) + ",0\r\n");
+          continue;
+        }
+        if (starts_with("AT+QIRD=")) {
+          int id = std::stoi(cmd.substr(8));
+          if (payloads->failing.count(id)) {
+            InjectRx(s, "\r\nERROR\r\n");
+            continue;
+          }
+          std::string body = payloads->bodies[id];
+          payloads->bodies[id].clear();
+          InjectRx(
+              s, "\r\n+QIRD: " + std::to_string(body.size()) + "\r\n" + body + "\r\n\r\nOK\r\n");
+          continue;
+        }
+        if (starts_with("AT+QICLOSE=")) {
+          int id = std::stoi(cmd.substr(11));
+          InjectRx(s, "OK\r\n");
+          InjectRx(s, "+QIURC: \"closed\"," + std::to_string(id) + "\r\n");
+          continue;
+        }
+        if (starts_with("AT+")) { InjectRx(s, "OK\r\n"); }
+      }
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    delete ctx;
+    vTaskDelete(nullptr);
+  };
+  auto *ctx = new std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, SocketPayloads *>(
+      s, done, payloads);
+  xTaskCreate(responder, "MULTI_SOCK", configMINIMAL_STACK_SIZE * 4, ctx, 3, nullptr);
+  vTaskDelay(pdMS_TO_TICKS(5));
+}
+
+static std::string readAll(AsyncGSM &client, size_t expected) {
+  std::string out;
+  uint8_t buf[64];
+  TickType_t t0 = xTaskGetTickCount();
+  while (out.size() < expected && (xTaskGetTickCount() - t0) < pdMS_TO_TICKS(2000)) {
+    int n = client.read(buf, sizeof(buf));
+    if (n > 0) {
+      out.append(reinterpret_cast<char *>(buf), n);
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+  }
+  return out;
+}
+
+class MultiSocketTest : public FreeRTOSTest {};
+
+TEST_F(MultiSocketTest, ClientsGetDistinctConnectIds) {
+  bool ok = runInFreeRTOSTask(
+      []() {
+        GSMContext ctx;
+        AsyncGSM a(ctx);
+        AsyncGSM b(ctx);
+        EXPECT_EQ(a.socket(), 0);
+        EXPECT_EQ(b.socket(), 1);
+        {
+          AsyncGSM c(ctx);
+          EXPECT_EQ(c.socket(), 2);
+        }
+        // Released ids are handed out again
+        AsyncGSM d(ctx);
+        EXPECT_EQ(d.socket(), 2);
+      },
+      "SocketIds", 8192, 2, 3000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MultiSocketTest, RoutesDataAndCloseBySocket) {
+  bool ok = runInFreeRTOSTask(
+      []() {
+        GSMContext ctx;
+        AsyncGSM a(ctx);
+        AsyncGSM b(ctx);
+
+        NiceMock<MockStream> mock;
+        mock.SetupDefaults();
+        ASSERT_TRUE(ctx.begin(mock));
+
+        std::atomic<bool> done{false};
+        SocketPayloads payloads;
+        payloads.bodies[0] = "payload-for-a";
+        payloads.bodies[1] = "a-different-payload-for-b";
+        startMultiSocketResponder(&mock, &done, &payloads);
+
+        ASSERT_EQ(a.connect("a.example.com", 80), 1);
+        ASSERT_EQ(b.connect("b.example.com", 8080), 1);
+
+        // Data for b is announced first; each client must only see its own bytes
+        InjectRx(&mock, "\r\n+QIURC: \"recv\",1\r\n");
+        InjectRx(&mock, "\r\n+QIURC: \"recv\",0\r\n");
+        vTaskDelay(pdMS_TO_TICKS(20));
+        EXPECT_EQ(readAll(b, 25), "a-different-payload-for-b");
+        EXPECT_EQ(readAll(a, 13), "payload-for-a");
+
+        // Closing b leaves a connected
+        b.stop();
+        EXPECT_FALSE(b.connected());
+        EXPECT_TRUE(a.connected());
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+        ctx.end();
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "MultiSocket", 8192, 2, 15000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(MultiSocketTest, FailedReadDoesNotShiftLaterReplies) {
+  bool ok = runInFreeRTOSTask(
+      []() {
+        GSMContext ctx;
+        AsyncGSM a(ctx);
+        AsyncGSM b(ctx);
+
+        NiceMock<MockStream> mock;
+        mock.SetupDefaults();
+        ASSERT_TRUE(ctx.begin(mock));
+
+        std::atomic<bool> done{false};
+        SocketPayloads payloads;
+        payloads.bodies[1] = "payload-for-b";
+        payloads.failing.insert(0);
+        startMultiSocketResponder(&mock, &done, &payloads);
+
+        ASSERT_EQ(a.connect("a.example.com", 80), 1);
+        ASSERT_EQ(b.connect("b.example.com", 8080), 1);
+
+        // a's read is answered with ERROR and no +QIRD; the next reply still belongs to b
+        InjectRx(&mock, "\r\n+QIURC: \"recv\",0\r\n");
+        InjectRx(&mock, "\r\n+QIURC: \"recv\",1\r\n");
+        vTaskDelay(pdMS_TO_TICKS(20));
+        EXPECT_EQ(a.available(), 0);
+        vTaskDelay(pdMS_TO_TICKS(20));
+        EXPECT_EQ(readAll(b, 13), "payload-for-b");
+        EXPECT_EQ(a.available(), 0);
+
+        // a can read again once the modem has data for it
+        payloads.failing.clear();
+        payloads.bodies[0] = "late-for-a";
+        InjectRx(&mock, "\r\n+QIURC: \"recv\",0\r\n");
+        vTaskDelay(pdMS_TO_TICKS(20));
+        EXPECT_EQ(readAll(a, 10), "late-for-a");
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+        ctx.end();
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "FailedRead", 8192, 2, 15000);
+  EXPECT_TRUE(ok);
+}
+
+FREERTOS_TEST_MAIN()
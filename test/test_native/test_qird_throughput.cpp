@@ -0,0 +1,132 @@
+#include <AsyncGSM.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "common/common.h"
+#include "common/responder.h"
+
+using ::testing::NiceMock;
+
+static constexpr size_t kStreamTotal = 2 * 1024 * 1024;
+static constexpr size_t kModemChunk = 1500;
+
+static inline uint8_t patternByte(size_t offset) {
+  return static_cast<uint8_t>((offset * 7 + 3) & 0xFF);
+}
+
+// Answers every AT+QIRD with the next slice of a deterministic binary body
+static void startQirdStreamResponder(NiceMock<MockStream> *s, std::atomic<bool> *done) {
+  auto responder = [](void *pv) {
+    using Ctx = std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, std::atomic<bool> *>;
+    auto *ctx = static_cast<Ctx *>(pv);
+    auto *s = std::get<0>(*ctx);
+    auto *done = std::get<1>(*ctx);
+    auto *started = std::get<2>(*ctx);
+
+    std::string acc;
+    size_t sent = 0;
+    if (started) started->store(true);
+    while (!done->load()) {
+      std::string chunk = s->GetTxData();
+      if (!chunk.empty()) acc += chunk;
+
+      size_t pos;
+      while ((pos = acc.find("\r\n")) != std::string::npos) {
+        std::string cmd = acc.substr(0, pos);
+        acc.erase(0, pos + 2);
+        if (cmd.rfind("AT+QIRD=", 0) != 0) continue;
+
+        size_t len = std::min(kModemChunk, kStreamTotal - sent);
+        std::string reply = "\r\n+QIRD: " + std::to_string(len) + "\r\n";
+        reply.reserve(reply.size() + len + 8);
+        for (size_t i = 0; i < len; ++i) { reply += static_cast<char>(patternByte(sent + i)); }
+        reply += "\r\n\r\nOK\r\n";
+        sent += len;
+        s->InjectRxData(reply);
+      }
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    delete started;
+    delete ctx;
+    vTaskDelete(nullptr);
+  };
+  auto *started = new std::atomic<bool>(false);
+  auto *ctx = new std::tuple<NiceMock<MockStream> *, std::atomic<bool> *, std::atomic<bool> *>(
+      s, done, started);
+  xTaskCreate(responder, "QIRD_STREAM", configMINIMAL_STACK_SIZE * 4, ctx, 3, nullptr);
+  TickType_t t0 = xTaskGetTickCount();
+  while (!started->load() && (xTaskGetTickCount() - t0) < pdMS_TO_TICKS(50)) {
+    vTaskDelay(pdMS_TO_TICKS(1));
+  }
+}
+
+class QirdThroughputTest : public FreeRTOSTest {
+ protected:
+  AsyncGSM *gsm{nullptr};
+  NiceMock<MockStream> *mock{nullptr};
+
+  void SetUp() override {
+    FreeRTOSTest::SetUp();
+    gsm = new AsyncGSM();
+    mock = new NiceMock<MockStream>();
+    mock->SetupDefaults();
+  }
+  void TearDown() override {
+    if (gsm) {
+      gsm->context().end();
+      vTaskDelay(pdMS_TO_TICKS(80));
+      delete gsm;
+    }
+    if (mock) delete mock;
+    FreeRTOSTest::TearDown();
+  }
+};
+
+TEST_F(QirdThroughputTest, StreamsMultiMegabyteBodyIntact) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mock));
+
+        std::atomic<bool> done{false};
+        startQirdStreamResponder(mock, &done);
+
+        auto t0 = std::chrono::steady_clock::now();
+        InjectRx(mock, "\r\n+QIURC: \"recv\",0\r\n");
+
+        uint8_t buf[512];
+        size_t received = 0;
+        size_t mismatches = 0;
+        TickType_t lastProgress = xTaskGetTickCount();
+        while (received < kStreamTotal) {
+          int n = gsm->read(buf, sizeof(buf));
+          if (n <= 0) {
+            if ((xTaskGetTickCount() - lastProgress) > pdMS_TO_TICKS(2000)) break;
+            vTaskDelay(pdMS_TO_TICKS(1));
+            continue;
+          }
+          for (int i = 0; i < n; ++i) {
+            if (buf[i] != patternByte(received + i)) mismatches++;
+          }
+          received += static_cast<size_t>(n);
+          lastProgress = xTaskGetTickCount();
+        }
+        double secs =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        BENCH_LOG(
+            "[BENCH] +QIRD stream: %zu bytes in %.2f s (%.1f KB/s)\n", received, secs,
+            secs > 0 ? received / secs / 1024.0 : 0.0);
+
+        EXPECT_EQ(received, kStreamTotal);
+        EXPECT_EQ(mismatches, 0u);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+      },
+      "QirdThroughput", 8192, 2, 25000);
+  EXPECT_TRUE(ok);
+}
+
+FREERTOS_TEST_MAIN()
@@ -0,0 +1,328 @@
+#include <utils/GSMTransport/GSMRingBuffer.h>
+#include <utils/GSMTransport/GSMTransport.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+#include "common/alloc_counter.h"
+#include "common/common.h"
+#include "common/responder.h"
+
+class RingBufferTest : public FreeRTOSTest {};
+
+TEST_F(RingBufferTest, WrapsAroundAndPreservesOrder) {
+  GSMRingBuffer rb(8);
+  const uint8_t first[] = {1, 2, 3, 4, 5, 6};
+  EXPECT_EQ(rb.write(first, sizeof(first)), sizeof(first));
+
+  uint8_t out[8] = {};
+  EXPECT_EQ(rb.read(out, 4), 4u);
+  EXPECT_EQ(out[0], 1);
+  EXPECT_EQ(out[3], 4);
+
+  // Crosses the end of the storage
+  const uint8_t second[] = {7, 8, 9, 10, 11};
+  EXPECT_EQ(rb.write(second, sizeof(second)), sizeof(second));
+  EXPECT_EQ(rb.size(), 7u);
+  EXPECT_EQ(rb.peek(), 5);
+
+  EXPECT_EQ(rb.read(out, sizeof(out)), 7u);
+  const uint8_t expected[] = {5, 6, 7, 8, 9, 10, 11};
+  for (size_t i = 0; i < sizeof(expected); ++i) { EXPECT_EQ(out[i], expected[i]); }
+  EXPECT_TRUE(rb.empty());
+  EXPECT_EQ(rb.peek(), -1);
+}
+
+TEST_F(RingBufferTest, WriteStopsAtCapacity) {
+  GSMRingBuffer rb(4);
+  const uint8_t data[] = {1, 2, 3, 4, 5, 6};
+  EXPECT_EQ(rb.write(data, sizeof(data)), 4u);
+  EXPECT_EQ(rb.space(), 0u);
+  EXPECT_EQ(rb.write(data, 1), 0u);
+}
+
+TEST_F(RingBufferTest, TransportCapacityIsClampedToMinimumChunk) {
+  GSMTransport transport;
+  ASSERT_TRUE(transport.setBufferCapacity(16));
+  EXPECT_EQ(transport.bufferCapacity(), GSMTransport::MIN_CHUNK_SIZE);
+}
+
+TEST_F(RingBufferTest, ChunkSizeIsBoundedByModemAndBuffer) {
+  GSMTransport transport;
+  transport.setChunkSize(4000);
+  EXPECT_EQ(transport.chunkSize(), GSMTransport::MAX_CHUNK_SIZE);
+  transport.setChunkSize(1);
+  EXPECT_EQ(transport.chunkSize(), GSMTransport::MIN_CHUNK_SIZE);
+
+  ASSERT_TRUE(transport.setBufferCapacity(512));
+  transport.setChunkSize(1500);
+  EXPECT_EQ(transport.chunkSize(), 512u);
+}
+
+TEST_F(RingBufferTest, TransportReadAndPeekSemantics) {
+  GSMTransport transport;
+  transport.deliverChunk(std::vector<uint8_t>{'a', 'b', 'c'});
+  EXPECT_EQ(transport.available(), 3u);
+  EXPECT_EQ(transport.peek(), 'a');
+  EXPECT_EQ(transport.read(), 'a');
+  uint8_t out[4] = {};
+  EXPECT_EQ(transport.read(out, sizeof(out)), 2u);
+  EXPECT_EQ(out[0], 'b');
+  EXPECT_EQ(out[1], 'c');
+  EXPECT_EQ(transport.read(), -1);
+  EXPECT_EQ(transport.peek(), -1);
+}
+
+TEST_F(RingBufferTest, ZeroCopyChunkSpansWrapAround) {
+  GSMTransport transport;
+  ASSERT_TRUE(transport.setBufferCapacity(1500));
+  std::vector<uint8_t> out(1500);
+
+  // Move the write position close to the end of the storage
+  transport.deliverChunk(std::vector<uint8_t>(1400, 0xAA));
+  EXPECT_EQ(transport.read(out.data(), out.size()), 1400u);
+
+  AllocSnapshot start = allocSnapshot();
+  size_t filled = 0;
+  uint8_t next = 0;
+  uint32_t token = transport.beginChunk();
+  while (filled < 300) {
+    uint8_t *dst = nullptr;
+    size_t room = transport.reserveChunk(token, &dst);
+    ASSERT_GT(room, 0u);
+    size_t n = std::min(room, 300 - filled);
+    for (size_t i = 0; i < n; ++i) { dst[i] = next++; }
+    ASSERT_TRUE(transport.commitChunk(token, n));
+    filled += n;
+  }
+  transport.finishChunk(filled);
+  EXPECT_EQ(allocSince(start).count, 0u);
+
+  EXPECT_EQ(transport.available(), 300u);
+  EXPECT_EQ(transport.read(out.data(), out.size()), 300u);
+  for (size_t i = 0; i < 300; ++i) { EXPECT_EQ(out[i], static_cast<uint8_t>(i)); }
+}
+
+TEST_F(RingBufferTest, ResetDiscardsPendingReservation) {
+  GSMTransport transport;
+  uint8_t *dst = nullptr;
+  uint32_t stale = transport.beginChunk();
+  ASSERT_GT(transport.reserveChunk(stale, &dst), 0u);
+  dst[0] = 'x';
+  transport.reset();
+
+  // The old reply neither commits nor gets room for the rest of its payload
+  EXPECT_FALSE(transport.commitChunk(stale, 1));
+  EXPECT_EQ(transport.reserveChunk(stale, &dst), 0u);
+  transport.finishChunk(1);
+  EXPECT_EQ(transport.available(), 0u);
+
+  // A reply that starts after the reset is delivered
+  uint32_t token = transport.beginChunk();
+  ASSERT_GT(transport.reserveChunk(token, &dst), 0u);
+  dst[0] = 'y';
+  EXPECT_TRUE(transport.commitChunk(token, 1));
+  transport.finishChunk(1);
+  EXPECT_EQ(transport.read(), 'y');
+}
+
+TEST_F(RingBufferTest, ResizeIsRefusedWhileChunkOutstanding) {
+  NiceMock<MockStream> stream;
+  stream.SetupDefaults();
+  GSMTransport transport;
+  transport.init(stream, nullptr);
+
+  // Requested: the reply is sized for the current buffer
+  transport.notifyDataReady(false);
+  transport.available();
+  EXPECT_EQ(DrainTx(&stream), "AT+QIRD=0,1500\r\n");
+  EXPECT_FALSE(transport.setBufferCapacity(256));
+
+  // Being read into the buffer
+  uint8_t *dst = nullptr;
+  uint32_t token = transport.beginChunk();
+  ASSERT_GT(transport.reserveChunk(token, &dst), 0u);
+  EXPECT_FALSE(transport.setBufferCapacity(256));
+  EXPECT_EQ(transport.bufferCapacity(), GSMRingBuffer::DEFAULT_CAPACITY);
+
+  transport.commitChunk(token, 0);
+  transport.finishChunk(0);
+  EXPECT_TRUE(transport.setBufferCapacity(256));
+}
+
+TEST_F(RingBufferTest, ReadAheadRequestsNextChunkBeforeDrain) {
+  NiceMock<MockStream> stream;
+  stream.SetupDefaults();
+  GSMTransport transport;
+  transport.init(stream, nullptr);
+
+  transport.notifyDataReady(false);
+  transport.available();
+  EXPECT_EQ(DrainTx(&stream), "AT+QIRD=0,1500\r\n");
+
+  // The reply path never requests itself; the application's next call does
+  transport.deliverChunk(std::vector<uint8_t>(1500, 'a'));
+  EXPECT_EQ(DrainTx(&stream), "");
+
+  // A full chunk leaves room for another one, so it is asked for before the buffer drains
+  EXPECT_EQ(transport.available(), 1500u);
+  EXPECT_EQ(DrainTx(&stream), "AT+QIRD=0,1500\r\n");
+
+  // Above the watermark nothing is requested until the application catches up
+  transport.deliverChunk(std::vector<uint8_t>(1500, 'b'));
+  EXPECT_EQ(transport.available(), 3000u);
+  EXPECT_EQ(DrainTx(&stream), "");
+
+  std::vector<uint8_t> out(1600);
+  EXPECT_EQ(transport.read(out.data(), out.size()), 1600u);
+  EXPECT_EQ(DrainTx(&stream), "AT+QIRD=0,1500\r\n");
+}
+
+TEST_F(RingBufferTest, ZeroWatermarkWaitsForEmptyBuffer) {
+  NiceMock<MockStream> stream;
+  stream.SetupDefaults();
+  GSMTransport transport;
+  transport.init(stream, nullptr);
+  transport.setReadAheadWatermark(0);
+
+  transport.notifyDataReady(false);
+  transport.available();
+  DrainTx(&stream);
+
+  transport.deliverChunk(std::vector<uint8_t>(1500, 'a'));
+  transport.available();
+  EXPECT_EQ(DrainTx(&stream), "");
+
+  std::vector<uint8_t> out(1500);
+  EXPECT_EQ(transport.read(out.data(), 1499), 1499u);
+  EXPECT_EQ(DrainTx(&stream), "");
+  EXPECT_EQ(transport.read(out.data(), 1), 1u);
+  EXPECT_EQ(DrainTx(&stream), "AT+QIRD=0,1500\r\n");
+}
+
+TEST_F(RingBufferTest, RequestsCarryConfiguredChunkSize) {
+  NiceMock<MockStream> stream;
+  stream.SetupDefaults();
+  GSMTransport transport;
+  transport.init(stream, nullptr);
+  transport.setChunkSize(256);
+
+  transport.notifyDataReady(true);
+  transport.available();
+  EXPECT_EQ(DrainTx(&stream), "AT+QSSLRECV=0,256\r\n");
+}
+
+TEST_F(RingBufferTest, AdaptiveChunkSizeFollowsTraffic) {
+  NiceMock<MockStream> stream;
+  stream.SetupDefaults();
+  GSMTransport transport;
+  transport.init(stream, nullptr);
+  transport.setChunkSize(256);
+  transport.setAdaptiveChunkSize(true);
+  std::vector<uint8_t> out(1500);
+
+  transport.notifyDataReady(false);
+  transport.available();
+  EXPECT_EQ(DrainTx(&stream), "AT+QIRD=0,256\r\n");
+
+  // Full replies double the next request up to the modem limit
+  transport.deliverChunk(std::vector<uint8_t>(256, 'a'));
+  transport.read(out.data(), out.size());
+  EXPECT_EQ(DrainTx(&stream), "AT+QIRD=0,512\r\n");
+  transport.deliverChunk(std::vector<uint8_t>(512, 'b'));
+  transport.read(out.data(), out.size());
+  EXPECT_EQ(DrainTx(&stream), "AT+QIRD=0,1024\r\n");
+  transport.deliverChunk(std::vector<uint8_t>(1024, 'c'));
+  transport.read(out.data(), out.size());
+  EXPECT_EQ(DrainTx(&stream), "AT+QIRD=0,1500\r\n");
+
+  // Trickle traffic shrinks it again
+  transport.deliverChunk(std::vector<uint8_t>(20, 'd'));
+  EXPECT_EQ(transport.chunkSize(), 750u);
+  transport.read(out.data(), out.size());
+  transport.notifyDataReady(false);
+  transport.available();
+  EXPECT_EQ(DrainTx(&stream), "AT+QIRD=0,750\r\n");
+}
+
+// Benchmark: previous std::deque<uint8_t> receive path vs. the ring buffer transport.
+// Only the receive store is measured; chunk construction happens outside the counters.
+struct RxBenchResult {
+  double bytesPerSec;
+  size_t allocations;
+  size_t allocatedBytes;
+};
+
+static constexpr size_t kBenchChunk = 1500;
+static constexpr size_t kBenchTotal = 4 * 1024 * 1024;
+static constexpr size_t kBenchRead = 512;
+
+static RxBenchResult runDequeBench() {
+  using Clock = std::chrono::steady_clock;
+  std::deque<uint8_t> buffer;
+  std::vector<uint8_t> out(kBenchRead);
+  Clock::duration elapsed{};
+  AllocSnapshot allocs{0, 0};
+
+  for (size_t sent = 0; sent < kBenchTotal; sent += kBenchChunk) {
+    std::vector<uint8_t> chunk(kBenchChunk, static_cast<uint8_t>(sent));
+    AllocSnapshot start = allocSnapshot();
+    auto t0 = Clock::now();
+    buffer.insert(buffer.end(), chunk.begin(), chunk.end());
+    while (!buffer.empty()) {
+      size_t n = std::min(out.size(), buffer.size());
+      for (size_t i = 0; i < n; ++i) {
+        out[i] = buffer.front();
+        buffer.pop_front();
+      }
+    }
+    elapsed += Clock::now() - t0;
+    AllocSnapshot delta = allocSince(start);
+    allocs.count += delta.count;
+    allocs.bytes += delta.bytes;
+  }
+  double secs = std::chrono::duration<double>(elapsed).count();
+  return {secs > 0 ? kBenchTotal / secs : 0, allocs.count, allocs.bytes};
+}
+
+static RxBenchResult runRingBench() {
+  using Clock = std::chrono::steady_clock;
+  GSMTransport transport;
+  std::vector<uint8_t> out(kBenchRead);
+  Clock::duration elapsed{};
+  AllocSnapshot allocs{0, 0};
+
+  for (size_t sent = 0; sent < kBenchTotal; sent += kBenchChunk) {
+    std::vector<uint8_t> chunk(kBenchChunk, static_cast<uint8_t>(sent));
+    AllocSnapshot start = allocSnapshot();
+    auto t0 = Clock::now();
+    transport.deliverChunk(std::move(chunk));
+    while (transport.read(out.data(), out.size()) > 0) {}
+    elapsed += Clock::now() - t0;
+    AllocSnapshot delta = allocSince(start);
+    allocs.count += delta.count;
+    allocs.bytes += delta.bytes;
+  }
+  double secs = std::chrono::duration<double>(elapsed).count();
+  return {secs > 0 ? kBenchTotal / secs : 0, allocs.count, allocs.bytes};
+}
+
+TEST_F(RingBufferTest, BenchmarkAgainstDequePath) {
+  RxBenchResult dequeResult = runDequeBench();
+  RxBenchResult ringResult = runRingBench();
+
+  BENCH_LOG(
+      "[BENCH] deque: %.1f MB/s, %zu allocations (%zu bytes)\n", dequeResult.bytesPerSec / 1e6,
+      dequeResult.allocations, dequeResult.allocatedBytes);
+  BENCH_LOG(
+      "[BENCH] ring : %.1f MB/s, %zu allocations (%zu bytes)\n", ringResult.bytesPerSec / 1e6,
+      ringResult.allocations, ringResult.allocatedBytes);
+
+  // The receive store must not touch the heap in steady state
+  EXPECT_EQ(ringResult.allocations, 0u);
+}
+
+FREERTOS_TEST_MAIN()
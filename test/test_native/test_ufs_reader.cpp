@@ -0,0 +1,120 @@
+#include <AsyncGSM.h>
+#include <utils/UFSReader/UFSReader.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "common/common.h"
+#include "common/responder.h"
+
+using ::testing::NiceMock;
+
+class UfsReaderTest : public FreeRTOSTest {
+ protected:
+  AsyncGSM *gsm{nullptr};
+  NiceMock<MockStream> *mock{nullptr};
+  std::string file;
+
+  void SetUp() override {
+    FreeRTOSTest::SetUp();
+    gsm = new AsyncGSM();
+    mock = new NiceMock<MockStream>();
+    mock->SetupDefaults();
+    for (size_t i = 0; i < 5000; i++) file.push_back(static_cast<char>((i * 13 + 5) & 0xFF));
+  }
+  void TearDown() override {
+    if (gsm) {
+      gsm->context().end();
+      vTaskDelay(pdMS_TO_TICKS(80));
+      delete gsm;
+    }
+    if (mock) delete mock;
+    FreeRTOSTest::TearDown();
+  }
+};
+
+TEST_F(UfsReaderTest, ServesSmallReadsFromBlocksAndLargeOnesDirectly) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mock));
+        std::atomic<bool> done{false};
+        UfsModem ufs;
+        ufs.files["spill.bin"] = file;
+        startUfsResponder(mock, &done, &ufs);
+
+        UFSReader reader(gsm->context().modem(), 1024);
+        ASSERT_TRUE(reader.open("spill.bin"));
+        EXPECT_EQ(reader.size(), file.size());
+        EXPECT_EQ(reader.available(), 5000);
+
+        std::string out;
+        EXPECT_EQ(reader.peek(), static_cast<uint8_t>(file[0]));
+        for (int i = 0; i < 10; i++) out.push_back(static_cast<char>(reader.read()));
+        std::vector<uint8_t> buf(3000);
+        EXPECT_EQ(reader.read(buf.data(), buf.size()), 3000u);
+        out.append(buf.begin(), buf.end());
+        char rest[2000];
+        EXPECT_EQ(reader.readBytes(rest, sizeof(rest)), 1990u);
+        out.append(rest, 1990);
+
+        EXPECT_EQ(out, file);
+        EXPECT_EQ(reader.available(), 0);
+        EXPECT_EQ(reader.read(), -1);
+        // One block for the byte reads; what the large reads still need goes straight into them
+        EXPECT_EQ(ufs.reads, (std::vector<size_t>{1024, 1986, 1990}));
+
+        reader.close();
+        EXPECT_TRUE(ufs.handles.empty());
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(30));
+      },
+      "UfsReaderBlocks", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(UfsReaderTest, SeeksWithoutARoundTripInsideTheBlock) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mock));
+        std::atomic<bool> done{false};
+        UfsModem ufs;
+        ufs.files["spill.bin"] = file;
+        startUfsResponder(mock, &done, &ufs);
+
+        UFSReader reader(gsm->context().modem(), 1024);
+        EXPECT_FALSE(reader.open("missing.bin"));
+        ASSERT_TRUE(reader.open("spill.bin"));
+
+        EXPECT_EQ(reader.read(), static_cast<uint8_t>(file[0]));
+        ASSERT_TRUE(reader.seek(500));
+        EXPECT_EQ(reader.read(), static_cast<uint8_t>(file[500]));
+        EXPECT_EQ(countPrefix(ufs.commands, "AT+QFSEEK="), 0u);
+
+        ASSERT_TRUE(reader.seek(4000));
+        EXPECT_EQ(reader.position(), 4000u);
+        EXPECT_EQ(reader.read(), static_cast<uint8_t>(file[4000]));
+        EXPECT_EQ(countPrefix(ufs.commands, "AT+QFSEEK="), 1u);
+        EXPECT_FALSE(reader.seek(5001));
+        reader.close();
+
+        // An ERROR reply fails the read at once instead of after the reply timeout
+        uint8_t buf[16];
+        TickType_t t0 = xTaskGetTickCount();
+        EXPECT_EQ(gsm->context().modem().readFile(7, buf, sizeof(buf)), -1);
+        EXPECT_LT(xTaskGetTickCount() - t0, pdMS_TO_TICKS(1000));
+
+        // With no file open, AT+QFUPL's CONNECT prompt is left to the upload
+        const uint8_t data[] = {1, 2, 3};
+        EXPECT_TRUE(gsm->context().modem().uploadUFSFile("small.bin", data, sizeof(data)));
+        EXPECT_EQ(ufs.files["small.bin"], std::string("\x01\x02\x03"));
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(30));
+      },
+      "UfsReaderSeek", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
+FREERTOS_TEST_MAIN()
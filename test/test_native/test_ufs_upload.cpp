@@ -0,0 +1,152 @@
+#include <AsyncGSM.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "common/common.h"
+#include "common/responder.h"
+
+using ::testing::NiceMock;
+
+class UfsUploadTest : public FreeRTOSTest {
+ protected:
+  AsyncGSM *gsm{nullptr};
+  NiceMock<MockStream> *mock{nullptr};
+  std::string file;
+
+  void SetUp() override {
+    FreeRTOSTest::SetUp();
+    gsm = new AsyncGSM();
+    mock = new NiceMock<MockStream>();
+    mock->SetupDefaults();
+    for (size_t i = 0; i < 5000; i++) file.push_back(static_cast<char>((i * 31 + 7) & 0xFF));
+  }
+  void TearDown() override {
+    if (gsm) {
+      gsm->context().end();
+      vTaskDelay(pdMS_TO_TICKS(80));
+      delete gsm;
+    }
+    if (mock) delete mock;
+    FreeRTOSTest::TearDown();
+  }
+
+  // Serves file up to limit bytes, recording the largest request
+  UFSUploadReader readerFor(size_t limit, size_t *offset, size_t *largest) {
+    return [this, limit, offset, largest](uint8_t *buf, size_t len) {
+      *largest = std::max(*largest, len);
+      size_t n = std::min(len, limit - *offset);
+      memcpy(buf, file.data() + *offset, n);
+      *offset += n;
+      return n;
+    };
+  }
+};
+
+TEST_F(UfsUploadTest, StreamsInBlocksAndVerifiesChecksum) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mock));
+        std::atomic<bool> done{false};
+        UfsModem ufs;
+        startUfsResponder(mock, &done, &ufs);
+
+        size_t offset = 0, largest = 0;
+        std::vector<size_t> progress;
+        EXPECT_TRUE(gsm->context().modem().uploadUFSFile(
+            "bundle.pem", file.size(), readerFor(file.size(), &offset, &largest),
+            [&](size_t sent, size_t total) {
+              EXPECT_EQ(total, file.size());
+              progress.push_back(sent);
+            }));
+
+        EXPECT_EQ(ufs.files["bundle.pem"], file);
+        EXPECT_EQ(largest, EG915_UFS_UPLOAD_BLOCK);
+        ASSERT_EQ(progress.size(), 10u);
+        EXPECT_EQ(progress.front(), EG915_UFS_UPLOAD_BLOCK);
+        EXPECT_EQ(progress.back(), file.size());
+        EXPECT_EQ(countPrefix(ufs.commands, "AT+QFDEL="), 0u);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(30));
+      },
+      "UfsStream", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(UfsUploadTest, ChecksumMismatchDeletesTheFile) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mock));
+        std::atomic<bool> done{false};
+        UfsModem ufs;
+        ufs.corruptChecksum = true;
+        startUfsResponder(mock, &done, &ufs);
+
+        EXPECT_FALSE(gsm->context().modem().uploadUFSFile(
+            "bundle.pem", reinterpret_cast<const uint8_t *>(file.data()), file.size()));
+        EXPECT_TRUE(sent(ufs.commands, "AT+QFDEL=\"bundle.pem\""));
+        EXPECT_EQ(ufs.files.count("bundle.pem"), 0u);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(30));
+      },
+      "UfsChecksum", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(UfsUploadTest, ChecksumIsComparedAsANumber) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mock));
+        std::atomic<bool> done{false};
+        UfsModem ufs;
+        startUfsResponder(mock, &done, &ufs);
+        // Checksum 0x262
+        const uint8_t data[] = {'a', 'b', 'c'};
+
+        // Zero-padded upper-case hex is the same checksum
+        ufs.checksumFormat = "%04X";
+        EXPECT_TRUE(gsm->context().modem().uploadUFSFile("bundle.pem", data, sizeof(data)));
+        EXPECT_EQ(countPrefix(ufs.commands, "AT+QFDEL="), 0u);
+
+        // A report that merely starts with the expected digits is not
+        ufs.checksumFormat = "%x0";
+        EXPECT_FALSE(gsm->context().modem().uploadUFSFile("bundle.pem", data, sizeof(data)));
+        EXPECT_TRUE(sent(ufs.commands, "AT+QFDEL=\"bundle.pem\""));
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(30));
+      },
+      "UfsChecksumNumber", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
+TEST_F(UfsUploadTest, ShortSourceIsPaddedOutAndDeleted) {
+  bool ok = runInFreeRTOSTask(
+      [this]() {
+        ASSERT_TRUE(gsm->context().begin(*mock));
+        std::atomic<bool> done{false};
+        UfsModem ufs;
+        startUfsResponder(mock, &done, &ufs);
+
+        size_t offset = 0, largest = 0;
+        size_t lastProgress = 0;
+        EXPECT_FALSE(gsm->context().modem().uploadUFSFile(
+            "bundle.pem", file.size(), readerFor(1000, &offset, &largest),
+            [&](size_t sent, size_t) { lastProgress = sent; }));
+        EXPECT_EQ(offset, 1000u);
+        EXPECT_EQ(lastProgress, 1000u);
+        // The modem got every byte it was promised, so later commands still line up
+        EXPECT_TRUE(sent(ufs.commands, "AT+QFDEL=\"bundle.pem\""));
+        EXPECT_EQ(ufs.files.count("bundle.pem"), 0u);
+
+        done = true;
+        vTaskDelay(pdMS_TO_TICKS(30));
+      },
+      "UfsShort", 8192, 3, 8000);
+  EXPECT_TRUE(ok);
+}
+
+FREERTOS_TEST_MAIN()
@@ -40,7 +40,8 @@ TEST_F(URCRegistrationTest, QIOPEN_URC_SetsConnected) {
         // CONNECTED
         InjectRx(mock, "\r\n+QIOPEN: 0,0\r\n");
         vTaskDelay(pdMS_TO_TICKS(20));
-        EXPECT_EQ(gsm->context().modem().URCState.isConnected.load(), ConnectionStatus::CONNECTED);
+        EXPECT_EQ(
+            gsm->context().modem().URCState.socketState[0].load(), ConnectionStatus::CONNECTED);
         gsm->context().end();
         vTaskDelay(pdMS_TO_TICKS(80));
       },
@@ -61,13 +62,13 @@ TEST_F(URCRegistrationTest, QIURCRecvDeferredUntilAvailable) {
         InjectRx(mock, "\r\n+QIURC: \"recv\"\r\n");
         vTaskDelay(pdMS_TO_TICKS(20));
         std::string tx = mock->GetTxData();
-        EXPECT_EQ(tx.find("AT+QIRD=0\r\n"), std::string::npos);
+        EXPECT_EQ(tx.find("AT+QIRD=0,"), std::string::npos);
 
         // Calling available() should trigger the read command
         EXPECT_EQ(gsm->available(), 0);
         vTaskDelay(pdMS_TO_TICKS(20));
         tx = mock->GetTxData();
-        EXPECT_NE(tx.find("AT+QIRD=0\r\n"), std::string::npos);
+        EXPECT_NE(tx.find("AT+QIRD=0,1500\r\n"), std::string::npos);
         gsm->context().end();
         vTaskDelay(pdMS_TO_TICKS(80));
       },